@@ -10,12 +10,17 @@
 
 #include <algorithm>
 #include <memory>
+#include <sstream>
 
 #include "ab_search.h"
 #include "cache.h"
 #include "eval.h"
+#include "eval_cache.h"
 #include "log.h"
+#include "material.h"
+#include "nnue.h"
 #include "nonstd.h"
+#include "tablebase.h"
 #include "util.h"
 
 namespace testudo
@@ -31,20 +36,49 @@ namespace
 constexpr int SORT_CAPTURE = std::numeric_limits<int>::max() - 1000000;
 constexpr int SORT_KILLER  = SORT_CAPTURE - 1000000;
 
+// Aspiration windows: initial half-width of the window and largest widening
+// step tried before falling back to a full window re-search.
+constexpr score ASPIRATION_DELTA     =   50;
+constexpr score ASPIRATION_MAX_DELTA = 1000;
+
+// Internal Iterative Deepening: minimum draft required and depth reduction of
+// the preliminary search.
+constexpr int IID_MIN_DRAFT = 5 * ab_search::PLY;
+constexpr int IID_REDUCTION = 2 * ab_search::PLY;
+
+// Internal Iterative Reduction: minimum draft required.
+constexpr int IIR_MIN_DRAFT = 6 * ab_search::PLY;
+
+// Draft of the transposition table entries storing tablebase scores.
+constexpr int TABLEBASE_DRAFT = std::numeric_limits<std::int16_t>::max();
+
+// Converts a tablebase score (mate distance relative to the probed position)
+// to the usual convention (distance from the root).
+score tablebase_score(score v, unsigned ply)
+{
+  if (v > 0)
+    return v - ply;
+  if (v < 0)
+    return v + ply;
+  return 0;
+}
+
 /*****************************************************************************
 // A convenient class to extract one move at time from the list of the legal
 // ones.
 // We don't sort the whole move list, but perform a selection sort each time a
 // move is fetched.
 // Root node is an exception requiring additional effort to score and sort
-// moves.
+// moves: they're sorted elsewhere and the provider just returns them in the
+// given order.
 *****************************************************************************/
 class move_provider
 {
 public:
-  enum class stage {hash = 0, move_gen, others};
+  enum class stage {hash = 0, move_gen, others, sorted};
 
-  move_provider(const state &, const cache::slot *);
+  move_provider(const state &, const cache::slot *,
+                const movelist * = nullptr);
 
   move next(const driver &, unsigned);
   bool empty();
@@ -62,10 +96,19 @@ private:
 // If there is a legal move from the hash table (`entry != nullptr`), move
 // generation can be delayed: often the move is enough to cause a cutoff and
 // save time.
-move_provider::move_provider(const state &s, const cache::slot *entry)
+// If an already sorted list of moves is available (`sorted != nullptr`), it's
+// used as is.
+move_provider::move_provider(const state &s, const cache::slot *entry,
+                             const movelist *sorted)
   : s_(s), stage_(stage::hash), from_cache_(move::sentry()), moves_(), start_()
 {
-  if (entry && entry->best_move() && s_.is_legal(entry->best_move()))
+  if (sorted)
+  {
+    moves_ = *sorted;
+    start_ = moves_.begin();
+    stage_ = stage::sorted;
+  }
+  else if (entry && entry->best_move() && s_.is_legal(entry->best_move()))
     from_cache_ = entry->best_move();
   else
   {
@@ -130,6 +173,9 @@ move move_provider::next(const driver &d, unsigned ply)
 
   switch (stage_)
   {
+  case stage::sorted:
+    return start_ == moves_.end() ? move::sentry() : *start_++;
+
   case stage::hash:
     stage_ = stage::move_gen;
     return from_cache_;
@@ -160,7 +206,7 @@ move move_provider::next(const driver &d, unsigned ply)
  * Driver
  *****************************************************************************/
 driver::driver(const std::vector<state> &ss)
-  : path(ss), killers(MAX_DEPTH), history()
+  : path(ss), killers(MAX_DEPTH), history(), pv(MAX_DEPTH)
 {
 }
 
@@ -194,6 +240,26 @@ void driver::upd_move_heuristics(const move &m, piece p, unsigned ply,
         history[i][sq] = (history[i][sq] + 1) / 2;
 }
 
+// Called every time the score of the node at distance `ply` from the root
+// improves (`m` being the move responsible): the PV of the node becomes `m`
+// followed by the PV of the child node.
+// The PV is collected during search so it doesn't suffer from overwritten
+// entries of the transposition table (PV nodes don't take table cutoffs).
+// It ends where the value of the position is known without searching
+// further: draws, tablebase positions and quiescence search.
+void driver::upd_pv(const move &m, unsigned ply)
+{
+  assert(m);
+  assert(ply + 1 < pv.size());
+
+  auto &line(pv[ply]);
+  const auto &child(pv[ply + 1]);
+
+  line.clear();
+  line.push_back(m);
+  line.insert(line.end(), child.begin(), child.end());
+}
+
 // Extraxt from the list of past known states (`ss`) a set of hash values used
 // for repetition detection.
 driver::path_info::path_info(const std::vector<state> &ss)
@@ -252,38 +318,80 @@ movelist ab_search::sorted_captures(const state &s)
 // searches capture sequences and allows the evaluation function to cut the
 // search off (and set alpha). The idea is to find a position where there
 // isn't a lot going on so the static evaluation function will work.
-score ab_search::quiesce(const state &s, score alpha, score beta)
+// The function is fail-soft: the returned value can be outside the
+// [alpha, beta] window (it's the best score found).
+score ab_search::quiesce(const state &s, score alpha, score beta,
+                         unsigned ply)
 {
   assert(alpha < beta);
 
   ++stats.qnodes;
 
+  // Positions covered by the endgame tablebases have an exact score.
+  score tb;
+  if (tablebase::probe(s, &tb))
+  {
+    ++stats.tbhits;
+    return tablebase_score(tb, ply);
+  }
+
   // The static evaluation is a "stand-pat" score (the term is taken from the
   // game of poker, where it denotes playing one's hand without drawing more
   // cards) and is used to establish a lower bound on the score.
   // Assuming we aren't in zugzwang, this is theoretically sound because we can
   // assume that there is at least one move that can either match or beat the
   // lower bound.
-  score x(eval(s));
+  //
+  // Lazy evaluation: the full (and more expensive) static evaluation is
+  // computed only when the cheap estimate isn't far enough from the window
+  // (classical evaluation only).
+  // The margin isn't a bound (see `LAZY_EVAL_MARGIN`) so this is a heuristic
+  // cutoff: it returns the limit of the window (fail-hard) instead of a
+  // fail-soft score that the estimate cannot guarantee.
+  score best(-INF);
+  bool full_eval(true);
+
+  if (!nnue::enabled())
+  {
+    const score estimate(lazy_eval(s));
 
-  if (x >= beta)
-    return beta;
-  if (x > alpha)
-    alpha = x;
+    if (estimate - LAZY_EVAL_MARGIN >= beta)
+      return beta;
+    if (estimate + LAZY_EVAL_MARGIN <= alpha)
+    {
+      best = alpha;
+      full_eval = false;
+    }
+  }
+
+  if (full_eval)
+  {
+    best = ec_ ? ec_->eval(s) : eval(s);
+
+    if (best >= beta)
+      return best;
+    if (best > alpha)
+      alpha = best;
+  }
 
   for (const auto &m : sorted_captures(s))
   {
-    x = -quiesce(s.after_move(m), -beta, -alpha);
+    const score x(-quiesce(s.after_move(m), -beta, -alpha, ply + 1));
 
-    if (x > alpha)
+    if (x > best)
     {
-      if (x >= beta)
-        return beta;
-      alpha = x;
+      best = x;
+
+      if (x > alpha)
+      {
+        if (x >= beta)
+          return x;
+        alpha = x;
+      }
     }
   }
 
-  return alpha;
+  return best;
 }
 
 movelist ab_search::sorted_moves(const state &s)
@@ -340,78 +448,6 @@ int ab_search::new_draft(int draft, bool in_check, const move &m) const
   return draft + std::min(0, delta);
 }
 
-// A slightly modified version of alphabeta (not stricly necessary but helps
-// to avoid a lot of `if`):
-// - the order of the moves is improved when a best move is found. This is
-//   possible since the root moves are "permanent" (they're kept inside the
-//   `stat` structure and are available even when the search is finished). THIS
-//   IS AN IMPORTANT DIFFERENCE;
-// - the function assumes that the position isn't a stalemate / immediate mate;
-// - the function ignores draw by repetition / 50 moves rule (we want a move).
-score ab_search::ab_root(score alpha, score beta, int draft)
-{
-  assert(alpha < beta);
-  assert(draft >= PLY);
-
-  ++stats.snodes;
-
-  // Don't push the current state in the `path` vector: `root_state_` is
-  // already present.
-  assert(driver_.path.back() == root_state_.hash());
-
-  auto &moves(stats.moves_at_root);
-  if (moves.empty())
-    moves = sorted_moves(root_state_);
-  assert(!moves.empty());
-
-  const bool in_check(root_state_.in_check());
-
-  auto best_move(move::sentry());
-  auto type(score_type::fail_low);
-
-  for (std::size_t i(0); i < moves.size(); ++i)
-  {
-    const auto d(new_draft(draft, in_check, moves[i]));
-
-    const auto s1(root_state_.after_move(moves[i]));
-    score x;
-    if (i == 0)
-      x = -ab(s1, -beta, -alpha, 1, d);
-    else
-    {
-      x = -ab(s1, -alpha - 1, -alpha, 1, d);
-      if (alpha < x && x < beta)
-        x = -ab(s1, -beta, -alpha, 1, d);
-    }
-
-    if (x > alpha)
-    {
-      best_move = moves[i];
-
-      // Moves at the root node are very important and they're kept in the
-      // best known order (given the search history).
-      std::copy_backward(&moves[0], &moves[i], &moves[i + 1]);
-      moves[0] = best_move;
-
-      if (x >= beta)
-      {
-        type = score_type::fail_high;
-        break;
-      }
-
-      alpha = x;
-      type = score_type::exact;
-    }
-  }
-
-  const auto val(type == score_type::fail_high ? beta : alpha);
-
-  if (!search_stopped_)
-    tt_->insert(root_state_.hash(), best_move, draft, type, val);
-
-  return val;
-}
-
 // Recursively implements negamax alphabeta until draft is exhausted, at which
 // time it calls `quiesce()`.
 // The `ply` index measures the distance of the current node from the root
@@ -421,14 +457,41 @@ score ab_search::ab_root(score alpha, score beta, int draft)
 // each time, the draft may be independently altered by various extension or
 // reduction-schemes and may also consider fractional extensions (values less
 // then `PLY`).
+//
+// The search is fail-soft: the returned value is the best score found even
+// when outside the [alpha, beta] window. This gives tighter bounds to the
+// transposition table and to the aspiration search.
+//
+// The function is specialized (at compile time) on the type of node:
+// - `node::root`. The order of the moves is improved when a best move is
+//   found. This is possible since the root moves are "permanent" (they're
+//   kept inside the `stat` structure and are available even when the search
+//   is finished). THIS IS AN IMPORTANT DIFFERENCE. The root node also assumes
+//   that the position isn't a stalemate / immediate mate and ignores draw by
+//   repetition / 50 moves rule (we want a move);
+// - `node::pv`. Nodes searched with an open window. They're responsible for
+//   the principal variation and perform re-searches;
+// - `node::non_pv`. Nodes searched with a null window (`alpha + 1 == beta`).
+//   The vast majority of the nodes: every book-keeping not strictly required
+//   is avoided.
+template<ab_search::node N>
 score ab_search::ab(const state &s, score alpha, score beta,
                     unsigned ply, int draft)
 {
+  constexpr bool root_node(N == node::root);
+  constexpr bool pv_node(N != node::non_pv);
+
   assert(alpha < beta);
-  assert(draft >= PLY);
+  assert(pv_node || alpha + 1 == beta);
+  assert(!root_node || (ply == 0 && draft >= PLY));
+
+  // Nodes returning before a move is searched (cutoffs, draws, quiescence...)
+  // have an empty PV.
+  if (pv_node)
+    driver_.pv[ply].clear();
 
   if (draft < PLY)
-    return quiesce(s, alpha, beta);
+    return quiesce(s, alpha, beta, ply);
 
   // Checks to see if we have searched enough nodes that it's time to peek at
   // how much time has been used / check for operator keyboard input.
@@ -444,122 +507,184 @@ score ab_search::ab(const state &s, score alpha, score beta,
       return 0;
   }
 
-  driver_.path.push(s);
-  auto guard = finally([&]{ driver_.path.pop(); });
-
-  // Draws. Check for draw by repetition / 50 move draws also. This is the
-  // quickest way to get out of further searching, with minimal effort.
-  if (driver_.path.repetitions() || s.fifty() >= 100)
-    return 0;
-
-  // Check to see if this position has been searched before. If so, we may get
-  // a real score, produce a cutoff or get nothing more than a good move to try
-  // first.
-  // There are four cases to handle:
-  // - `score_type::exact`. Return the score, no further searching is needed
-  //   from this position.
-  // - `score_type::fail_low` which means that when this position was searched
-  //   previously, every move was "refuted" by one of its descendents. As a
-  //   result, when the search was completed, we returned `alpha` at that
-  //   point. If the previous was lower than alpha we simply return `alpha`
-  //   here as well.
-  // - `score_type::fail_high` which means that when we encountered this
-  //   position before, we searched one branch (probably) which promptly
-  //   refuted the move at the previous ply.
-  const auto entry(tt_->find(s.hash()));
-  if (entry && entry->draft() >= draft)
-    switch (entry->type())
+  // Don't push the root state in the `path` vector: it's already present.
+  if (!root_node)
+    driver_.path.push(s);
+  auto guard = finally([&]{ if (!root_node) driver_.path.pop(); });
+
+  const cache::slot *entry(nullptr);
+
+  if (!root_node)
+  {
+    // Draws. Check for draw by repetition / 50 move draws / insufficient
+    // material / proven endgame draws also (positions in check are searched
+    // anyway: with a minor piece a mate is still possible). This is the
+    // quickest way to get out of further searching, with minimal effort.
+    if (driver_.path.repetitions() || s.fifty() >= 100)
+      return 0;
+
+    const material_entry &me(material_db.probe(s));
+    if ((me.draw && !s.in_check()) || endgame::proven_draw(s, me.endgame))
+      return 0;
+
+    // Check to see if this position has been searched before. If so, we may
+    // get a real score, produce a cutoff or get nothing more than a good move
+    // to try first.
+    // There are four cases to handle:
+    // - `score_type::exact`. Return the score, no further searching is needed
+    //   from this position.
+    // - `score_type::fail_low` which means that when this position was
+    //   searched previously, every move was "refuted" by one of its
+    //   descendents. As a result, when the search was completed, we got an
+    //   upper bound for the score. If the bound is lower than alpha we simply
+    //   return it.
+    // - `score_type::fail_high` which means that when we encountered this
+    //   position before, we searched one branch (probably) which promptly
+    //   refuted the move at the previous ply. The stored lower bound produces
+    //   a cutoff if it's greater than beta.
+    // PV nodes never take a cutoff: the table cannot provide the PV below
+    // them (see `driver::upd_pv`). The entry is still used for move ordering.
+    entry = tt_->find(s.hash());
+    if (!pv_node && entry && entry->draft() >= draft)
     {
-    case score_type::fail_low:
-      if (entry->value() <= alpha)
-        return alpha;
-      break;
-    case score_type::fail_high:
-      if (entry->value() >= beta)
-        return beta;
-      break;
-    default:
-      assert(entry->type() == score_type::exact);
-      return entry->value();
+      const auto v(entry->value(ply));
+
+      switch (entry->type())
+      {
+      case score_type::fail_low:
+        if (v <= alpha)
+        {
+          tt_->cutoff();
+          return v;
+        }
+        break;
+      case score_type::fail_high:
+        if (v >= beta)
+        {
+          tt_->cutoff();
+          return v;
+        }
+        break;
+      default:
+        assert(entry->type() == score_type::exact);
+        tt_->cutoff();
+        return v;
+      }
     }
 
-  move_provider moves(s, entry);
+    // Endgame tablebases. The score is exact whatever the remaining draft,
+    // so it's stored with the largest one (the entry won't be replaced by a
+    // shallower search).
+    score tb;
+    if (tablebase::probe(s, &tb))
+    {
+      ++stats.tbhits;
+
+      const score v(tablebase_score(tb, ply));
+      tt_->insert(s.hash(), move::sentry(), TABLEBASE_DRAFT,
+                  score_type::exact, v, ply);
+      return v;
+    }
+
+    // Without a move from the transposition table, the first move is chosen
+    // by the (weak) static move ordering. At PV nodes with enough draft a bad
+    // first move is very expensive, so a reduced depth search is performed
+    // to get a good move to try first (Internal Iterative Deepening).
+    if (pv_node && draft >= IID_MIN_DRAFT && (!entry || !entry->best_move()))
+    {
+      // The nested search pushes the current state again.
+      driver_.path.pop();
+      ab<N>(s, alpha, beta, ply, draft - IID_REDUCTION);
+      driver_.path.push(s);
+
+      if (search_stopped_)
+        return 0;
+
+      entry = tt_->find(s.hash());
+    }
+
+    // At non-PV nodes the cheaper alternative is simply to reduce the draft
+    // (Internal Iterative Reduction): the node is probably less important
+    // than expected and the reduced search will store a move for the next
+    // iteration.
+    if (!pv_node && draft >= IIR_MIN_DRAFT && (!entry || !entry->best_move())
+        && !s.in_check())
+      draft -= PLY;
+  }
+
+  auto &root_moves(stats.moves_at_root);
+  if (root_node && root_moves.empty())
+    root_moves = sorted_moves(s);
+
+  move_provider moves(s, entry, root_node ? &root_moves : nullptr);
   const bool in_check(s.in_check());
 
-  if (moves.empty())
+  if (!root_node && moves.empty())
     return in_check ? -INF + ply : 0;
+  assert(!moves.empty());
 
   auto best_move(move::sentry());
   auto type(score_type::fail_low);
+  score best(-INF);
   bool first(true);
 
   for (move m; (m = moves.next(driver_, ply));)
   {
     const auto d(new_draft(draft, in_check, m));
 
+    // Quiescence nodes don't access the transposition table.
+    if (d >= PLY)
+      tt_->prefetch(s.key_after(m));
+
     const auto s1(s.after_move(m));
     score x;
-    if (first)
-    {
-      x = -ab(s1, -beta, -alpha, ply + 1, d);
-      first = false;
-    }
+    if (pv_node && first)
+      x = -ab<node::pv>(s1, -beta, -alpha, ply + 1, d);
     else
     {
-      x = -ab(s1, -alpha - 1, -alpha, ply + 1, d);
-      if (alpha < x && x < beta)
-        x = -ab(s1, -beta, -alpha, ply + 1, d);
+      x = -ab<node::non_pv>(s1, -alpha - 1, -alpha, ply + 1, d);
+      if (pv_node && alpha < x && x < beta)
+        x = -ab<node::pv>(s1, -beta, -alpha, ply + 1, d);
     }
+    first = false;
+
+    if (x > best)
+      best = x;
 
     if (x > alpha)
     {
       best_move = m;
 
+      // Moves at the root node are very important and they're kept in the
+      // best known order (given the search history).
+      if (root_node)
+      {
+        const auto where(std::find(root_moves.begin(), root_moves.end(), m));
+        assert(where != root_moves.end());
+        std::rotate(root_moves.begin(), where, std::next(where));
+      }
+
       if (x >= beta)
       {
         type = score_type::fail_high;
 
-        if (is_quiet(m))
+        if (!root_node && is_quiet(m))
           driver_.upd_move_heuristics(m, s[m.from], ply, draft);
         break;
       }
 
       type = score_type::exact;
       alpha = x;
+
+      if (pv_node)
+        driver_.upd_pv(m, ply);
     }
   }
 
-  const auto val(type == score_type::fail_high ? beta : alpha);
-
   if (!search_stopped_)
-    tt_->insert(s.hash(), best_move, draft, type, val);
-
-  return val;
-}
-
-// Extract the PV from the transposition table.
-// At least one move should always be availeble (even in case of immediate
-// draw).
-movelist ab_search::extract_pv() const
-{
-  std::vector<hash_t> history(driver_.path.states);
-
-  auto s(root_state_);
-
-  movelist pv;
-  for (auto entry(tt_->find(s.hash()));
-       entry && entry->best_move()
-       && pv.size() <= 3 * stats.depth
-       && (s.mate_or_draw(&history) == state::kind::standard || pv.empty())
-       && s.make_move(entry->best_move());)
-  {
-    history.push_back(s.hash());
+    tt_->insert(s.hash(), best_move, draft, type, best, ply);
 
-    pv.push_back(entry->best_move());
-    entry = tt_->find(s.hash());
-  }
-
-  return pv;
+  return best;
 }
 
 // Aspiration windows are a way to reduce the search space in an alpha-beta
@@ -569,32 +694,61 @@ movelist ab_search::extract_pv() const
 // alpha-beta bounds. Because the window is narrower, more beta cutoffs are
 // achieved and the search takes a shorter time.
 // The drawback is that if the true score is outside this window, then a costly
-// re-search must be made.
+// re-search must be made. Instead of immediately re-searching with an infinite
+// window, we progressively widen the window: this keeps most of the benefit
+// of the narrow window in volatile positions.
 score ab_search::aspiration_search(score *alpha, score *beta, int draft)
 {
-  auto x(ab_root(*alpha, *beta, draft));
+  score delta(ASPIRATION_DELTA);
 
-  if (search_stopped_)
-    return 0;
-
-  if (x <= *alpha || x >= *beta)
+  for (;;)
   {
+    const auto nodes(stats.snodes + stats.qnodes);
+    const auto x(ab<node::root>(root_state_, *alpha, *beta, 0, draft));
+
+    if (search_stopped_)
+      return 0;
+
+    if (*alpha < x && x < *beta)
+    {
+      stats.score_at_root = x;
+
+      *alpha = std::max(x - ASPIRATION_DELTA, -INF);
+      *beta  = std::min(x + ASPIRATION_DELTA, +INF);
+
+      return x;
+    }
+
     testudoOUTPUT << stats.depth << ' ' << (x <= *alpha ? "--" : "++") << ' '
                   << search_timer_.elapsed().count() / 10 << ' '
                   << stats.snodes << ' ' << stats.moves_at_root.front();
 
-    x = ab_root(-INF, +INF, draft);
-  }
-
-  if (search_stopped_)
-    return 0;
-
-  stats.score_at_root = x;
+    stats.research_nodes += stats.snodes + stats.qnodes - nodes;
 
-  *alpha = x - 50;
-  *beta  = x + 50;
+    // The window is widened in the failing direction (by an increasing
+    // amount) while the other bound is moved toward the returned score.
+    // After too many failures (search instability) we fall back to the full
+    // window.
+    if (x <= *alpha)
+    {
+      ++stats.fail_low;
+      *beta  = (*alpha + *beta) / 2;
+      *alpha = std::max(x - delta, -INF);
+    }
+    else
+    {
+      ++stats.fail_high;
+      *alpha = (*alpha + *beta) / 2;
+      *beta  = std::min(x + delta, +INF);
+    }
 
-  return x;
+    delta += delta / 2;
+    if (delta > ASPIRATION_MAX_DELTA)
+    {
+      *alpha = -INF;
+      *beta  = +INF;
+    }
+  }
 }
 
 // Calls `aspiration_search` with increasing depth until allocated resources
@@ -616,16 +770,42 @@ move ab_search::run(bool verbose)
   default:
     search_timer_.restart();
     tt_->inc_age();
+    tt_->stats.reset();
+    if (ec_)
+      ec_->stats.reset();
     stats.reset();
  }
 
   move best_move(move::sentry());
 
+  const unsigned max(constraint.max_depth ? constraint.max_depth : 1000);
+
   score alpha(-INF), beta(+INF);
   stats.depth = 1;
-  for (unsigned max(constraint.max_depth ? constraint.max_depth : 1000);
-       stats.depth <= max;
-       ++stats.depth)
+
+  // If the table has been restored from a snapshot containing an analysis of
+  // the root position, the iterations up to the stored depth are skipped: the
+  // first one starts at the previous depth and is fast thanks to the
+  // transposition table.
+  // This isn't done during normal play: the root is usually on the previous
+  // PV and starting two plies short of the previous depth loses the move
+  // ordering information (killers, history) gathered by the shallow
+  // iterations and could exceed a short time limit.
+  const auto *entry(resume ? tt_->find(root_state_.hash()) : nullptr);
+  if (entry && entry->type() == score_type::exact && entry->best_move())
+  {
+    stats.depth = std::min<unsigned>(std::max(entry->draft() / PLY, 1), max);
+
+    alpha = std::max(entry->value() - ASPIRATION_DELTA, -INF);
+    beta  = std::min(entry->value() + ASPIRATION_DELTA, +INF);
+
+    // The first (deep) iteration could be interrupted: the stored move is
+    // the fallback.
+    if (root_state_.is_legal(entry->best_move()))
+      best_move = entry->best_move();
+  }
+
+  for (; stats.depth <= max; ++stats.depth)
   {
     const auto x(aspiration_search(&alpha, &beta, stats.depth * PLY));
 
@@ -633,18 +813,40 @@ move ab_search::run(bool verbose)
       break;
 
     best_move = stats.moves_at_root.front();
-    const auto pv(extract_pv());
+    const auto &pv(driver_.pv.front());
     assert(pv.front() == best_move);
 
+    stats.tt = tt_->stats;
+    stats.hashfull = tt_->hashfull();
+    if (ec_)
+      stats.ec = ec_->stats;
+
     if (verbose)
     {
+      std::ostringstream tt_info;
+      if (cache::stats_enabled)
+      {
+        const auto probes(std::max<std::uintmax_t>(stats.tt.probes, 1));
+
+        tt_info << " {hashfull " << stats.hashfull
+                << " hits " << stats.tt.hits * 100 / probes
+                << "% cutoffs " << stats.tt.cutoffs * 100 / probes << '%';
+
+        if (stats.ec.probes)
+          tt_info << " evalhits " << stats.ec.hits * 100 / stats.ec.probes
+                  << '%';
+
+        tt_info << '}';
+      }
+
       testudoOUTPUT << stats.depth << ' ' << x << ' '
                     << search_timer_.elapsed().count() / 10 << ' '
-                    << stats.snodes << ' ' << pv;
+                    << stats.snodes << ' ' << pv << tt_info.str();
     }
 
+    // A resumed search could start beyond the fifth iteration.
     if (is_mate(x)
-        || (root_state_.moves().size() == 1 && stats.depth == 5))
+        || (root_state_.moves().size() == 1 && stats.depth >= 5))
       break;
 
     // Custom early exit condition.
@@ -652,6 +854,15 @@ move ab_search::run(bool verbose)
       break;
   }
 
+  // Search stopped before the end of the first iteration.
+  if (!best_move && !stats.moves_at_root.empty())
+    best_move = stats.moves_at_root.front();
+
+  stats.tt = tt_->stats;
+  stats.hashfull = tt_->hashfull();
+  if (ec_)
+    stats.ec = ec_->stats;
+
   return best_move;
 }
 
@@ -18,6 +18,7 @@ namespace testudo
 {
 
 class cache;
+class eval_cache;
 
 struct driver
 {
@@ -39,9 +40,15 @@ struct driver
   } path;
 
   void upd_move_heuristics(const move &, piece p, unsigned, unsigned);
+  void upd_pv(const move &, unsigned);
 
   std::vector<std::pair<move, move>> killers;
   int history[piece::sup_id][64];
+
+  // Triangular PV array: `pv[ply]` is the principal variation found for the
+  // node at distance `ply` from the root (`pv[0]` is the PV of the whole
+  // search).
+  std::vector<movelist> pv;
 };
 
 class ab_search : public search
@@ -51,19 +58,23 @@ public:
   // We extend/reduce in fractions of one ply (reason why `PLY != 1`).
   static constexpr int PLY = 4;
 
-  ab_search(const std::vector<state> &, cache *);
+  ab_search(const std::vector<state> &, cache *, eval_cache * = nullptr);
 
   move run(bool) final;
 
+  // `true` if the transposition table has been restored from a snapshot
+  // (see `cache::load`): the search resumes from the stored depth.
+  bool resume;
+
 private:
   static constexpr std::uintmax_t nodes_between_checks = 2048;
 
-  score ab(const state &, score, score, unsigned, int);
-  score ab_root(score, score, int);
+  enum class node {root, pv, non_pv};
+
+  template<node> score ab(const state &, score, score, unsigned, int);
   score aspiration_search(score *, score *, int);
   int new_draft(int, bool, const move &) const;
-  movelist extract_pv() const;
-  int quiesce(const state &, score, score);
+  int quiesce(const state &, score, score, unsigned);
   movelist sorted_captures(const state &);
   movelist sorted_moves(const state &);
 
@@ -72,6 +83,7 @@ private:
   driver driver_;
 
   cache *tt_;
+  eval_cache *ec_;
 
   timer  search_timer_;
 };  // class ab_search
@@ -80,9 +92,11 @@ private:
 //   partial list (e.g. for FEN positions) but `states.back()` must contain the
 //   current state.
 // - `tt` is a pointer to an external hash table.
-inline ab_search::ab_search(const std::vector<state> &states, cache *tt)
-  : search(), root_state_(states.back()), driver_(states), tt_(tt),
-    search_timer_()
+// - `ec` is a pointer to an external evaluation cache (optional).
+inline ab_search::ab_search(const std::vector<state> &states, cache *tt,
+                            eval_cache *ec)
+  : search(), resume(false), root_state_(states.back()), driver_(states),
+    tt_(tt), ec_(ec), search_timer_()
 {
   assert(!states.empty());
   assert(tt);
@@ -0,0 +1,173 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include "attacks.h"
+#include "state.h"
+
+namespace testudo
+{
+
+namespace
+{
+
+// Ray directions (file / rank steps). The first four ones move towards
+// higher square indexes (the first blocker is the least significant bit of
+// the blockers), the other ones towards lower indexes.
+enum direction {south, east, south_east, south_west,
+                north, west, north_west, north_east, directions};
+
+const int DF[directions] = {0, 1,  1, -1, 0, -1, -1,  1};
+const int DR[directions] = {-1, 0, -1, -1, 1,  0,  1,  1};
+
+struct attack_tables
+{
+  attack_tables();
+
+  bitboard knight[64];
+  bitboard king[64];
+  bitboard ray[directions][64];  // empty board
+};
+
+attack_tables::attack_tables() : knight(), king(), ray()
+{
+  const int KNIGHT_DF[8] = {1, 2, 2, 1, -1, -2, -2, -1};
+  const int KNIGHT_DR[8] = {2, 1, -1, -2, -2, -1, 1, 2};
+
+  for (square sq(0); sq < 64; ++sq)
+  {
+    const int f(file(sq)), r(rank(sq));
+
+    for (unsigned i(0); i < 8; ++i)
+    {
+      const square to(to_square(f + KNIGHT_DF[i], r + KNIGHT_DR[i]));
+      if (valid(to))
+        knight[sq] |= bb(to);
+    }
+
+    for (unsigned d(0); d < directions; ++d)
+    {
+      const square to(to_square(f + DF[d], r + DR[d]));
+      if (valid(to))
+        king[sq] |= bb(to);
+
+      for (int k(1); valid(to_square(f + k * DF[d], r + k * DR[d])); ++k)
+        ray[d][sq] |= bb(to_square(f + k * DF[d], r + k * DR[d]));
+    }
+  }
+}
+
+const attack_tables tables;
+
+// Squares attacked along direction `D`: the ray is cut behind the first
+// occupied square.
+// H1 / A8 are added to the blockers as sentinels (the rays starting from
+// them in the respective directions are empty): this avoids a hard to
+// predict branch for the empty ray.
+template<direction D>
+bitboard ray_attacks(square sq, bitboard occupied) noexcept
+{
+  const bitboard ray(tables.ray[D][sq]);
+  const bitboard blockers(ray & occupied);
+
+  return ray ^ tables.ray[D][D < north ? lsb(blockers | bb(H1))
+                                       : msb(blockers | bb(A8))];
+}
+
+}  // unnamed namespace
+
+bitboard knight_attacks(square sq) noexcept
+{
+  assert(0 <= sq && sq < 64);
+  return tables.knight[sq];
+}
+
+bitboard king_attacks(square sq) noexcept
+{
+  assert(0 <= sq && sq < 64);
+  return tables.king[sq];
+}
+
+bitboard bishop_attacks(square sq, bitboard occupied) noexcept
+{
+  assert(0 <= sq && sq < 64);
+  return ray_attacks<south_east>(sq, occupied)
+         | ray_attacks<south_west>(sq, occupied)
+         | ray_attacks<north_west>(sq, occupied)
+         | ray_attacks<north_east>(sq, occupied);
+}
+
+bitboard rook_attacks(square sq, bitboard occupied) noexcept
+{
+  assert(0 <= sq && sq < 64);
+  return ray_attacks<south>(sq, occupied) | ray_attacks<east>(sq, occupied)
+         | ray_attacks<north>(sq, occupied) | ray_attacks<west>(sq, occupied);
+}
+
+bitboard attacks(enum piece::type t, square sq, bitboard occupied) noexcept
+{
+  switch (t)
+  {
+  case piece::knight:  return knight_attacks(sq);
+  case piece::bishop:  return bishop_attacks(sq, occupied);
+  case piece::rook:    return rook_attacks(sq, occupied);
+  case piece::queen:   return bishop_attacks(sq, occupied)
+                              | rook_attacks(sq, occupied);
+  case piece::king:    return king_attacks(sq);
+  default:             assert(false);  return 0;
+  }
+}
+
+attack_map::attack_map(const state &s)
+  : pieces(), occupancy(), occupied(0), attacked_by(), attacked(),
+    attacked2(), list_size()
+{
+  for (unsigned c(0); c < 2; ++c)
+  {
+    for (unsigned t(piece::pawn); t <= piece::queen; ++t)
+      pieces[c][t] = s.pieces(c, static_cast<enum piece::type>(t));
+
+    occupancy[c] = s.pieces(c);
+    occupied |= occupancy[c];
+  }
+
+  for (unsigned c(0); c < 2; ++c)
+  {
+    // Pawns are processed set-wise: a square attacked from both sides is
+    // attacked twice.
+    const bitboard fwd(shift_fwd(c, pieces[c][piece::pawn]));
+    attacked2[c] = shift_east(fwd) & shift_west(fwd);
+    attacked_by[c][piece::pawn] = pawn_attacks(c, pieces[c][piece::pawn]);
+    attacked[c] = attacked_by[c][piece::pawn];
+
+    const auto add([&](enum piece::type t, bitboard to)
+                   {
+                     attacked_by[c][t] |= to;
+                     attacked2[c] |= attacked[c] & to;
+                     attacked[c] |= to;
+                   });
+
+    for (auto t : {piece::knight, piece::bishop, piece::rook, piece::queen})
+      for (bitboard b(pieces[c][t]); b; b &= b - 1)
+      {
+        const square from(lsb(b));
+        const bitboard to(attacks(t, from, occupied));
+
+        assert(list_size[c] < 15);
+        list[c][list_size[c]++] = {t, from, to};
+
+        add(t, to);
+      }
+
+    if (pieces[c][piece::king])
+      add(piece::king, king_attacks(lsb(pieces[c][piece::king])));
+  }
+}
+
+}  // namespace testudo
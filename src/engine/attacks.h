@@ -0,0 +1,67 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_ATTACKS_H)
+#define      TESTUDO_ATTACKS_H
+
+#include "bitboard.h"
+#include "piece.h"
+
+namespace testudo
+{
+
+class state;
+
+// Squares attacked by a single piece. Sliding pieces stop at the first
+// occupied square (`occupied` is the set of all the pieces on the board).
+extern bitboard knight_attacks(square) noexcept;
+extern bitboard king_attacks(square) noexcept;
+extern bitboard bishop_attacks(square, bitboard) noexcept;
+extern bitboard rook_attacks(square, bitboard) noexcept;
+extern bitboard attacks(enum piece::type, square, bitboard) noexcept;
+
+// Squares attacked by a set of pawns of color `c`.
+inline constexpr bitboard pawn_attacks(color c, bitboard pawns) noexcept
+{
+  return shift_east(shift_fwd(c, pawns)) | shift_west(shift_fwd(c, pawns));
+}
+
+// Every square attacked by every piece of a position. The maps are built
+// once per evaluated node with set-wise operations and precomputed tables
+// (walking the mailbox, as the move generator does, would be too slow) and
+// then shared by all the terms based on attacks (mobility, king safety...).
+struct attack_map
+{
+  explicit attack_map(const state &);
+
+  bitboard pieces[2][6];  // by color and type (see `piece::type`)
+  bitboard occupancy[2];  // all the pieces of a color
+  bitboard occupied;      // all the pieces
+
+  bitboard attacked_by[2][6];  // squares attacked by color and piece type
+  bitboard attacked[2];        // squares attacked by at least one piece
+  bitboard attacked2[2];       // squares attacked by at least two pieces
+
+  // Squares attacked by every single knight, bishop, rook and queen (e.g.
+  // for mobility). A side can have at most 15 of them.
+  struct piece_attacks
+  {
+    enum piece::type type;
+    square from;
+    bitboard to;
+  };
+
+  piece_attacks list[2][15];
+  unsigned list_size[2];
+};
+
+}  // namespace testudo
+
+#endif  // include guard
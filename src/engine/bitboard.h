@@ -0,0 +1,144 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_BITBOARD_H)
+#define      TESTUDO_BITBOARD_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+#include "square.h"
+
+namespace testudo
+{
+
+// A set of squares: bit `i` corresponds to square `i` (so the least
+// significant bit is A8 and the most significant one is H1).
+// The board is represented via a mailbox but bitboards allow set-wise
+// computations (e.g. pawn structure evaluation) with a few shift and mask
+// operations.
+using bitboard = std::uint64_t;
+
+constexpr bitboard FILE_A_BB = 0x0101010101010101ull;
+constexpr bitboard FILE_H_BB = FILE_A_BB << 7;
+
+// Dark squares (A1, C1... H8).
+constexpr bitboard DARK_SQUARES_BB = 0x55AA55AA55AA55AAull;
+
+inline constexpr bitboard bb(square s) noexcept
+{
+  assert(0 <= s && s < 64);
+  return bitboard(1) << s;
+}
+
+inline constexpr bitboard file_bb(unsigned f) noexcept
+{
+  assert(f < 8);
+  return FILE_A_BB << f;
+}
+
+// Rank `r` from the point of view of color `c` (see `rank(color, square)`).
+inline constexpr bitboard rank_bb(color c, unsigned r) noexcept
+{
+  assert(r < 8);
+  return bitboard(0xFF) << 8 * (c == BLACK ? r : 7 - r);
+}
+
+inline unsigned popcount(bitboard b) noexcept
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(b);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  return static_cast<unsigned>(__popcnt64(b));
+#else
+  unsigned n(0);
+  for (; b; b &= b - 1)
+    ++n;
+  return n;
+#endif
+}
+
+// Index of the least / most significant bit set (`b` must not be empty).
+inline square lsb(bitboard b) noexcept
+{
+  assert(b);
+#if defined(__GNUC__)
+  return static_cast<square>(__builtin_ctzll(b));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long i;
+  _BitScanForward64(&i, b);
+  return static_cast<square>(i);
+#else
+  square i(0);
+  for (; !(b & 1); b >>= 1)
+    ++i;
+  return i;
+#endif
+}
+
+inline square msb(bitboard b) noexcept
+{
+  assert(b);
+#if defined(__GNUC__)
+  return static_cast<square>(63 - __builtin_clzll(b));
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long i;
+  _BitScanReverse64(&i, b);
+  return static_cast<square>(i);
+#else
+  square i(63);
+  for (; !(b >> 63); b <<= 1)
+    --i;
+  return i;
+#endif
+}
+
+// Moves every square one step forward / backward from the point of view of
+// color `c` (see `step_fwd`).
+inline constexpr bitboard shift_fwd(color c, bitboard b) noexcept
+{ return c == BLACK ? b << 8 : b >> 8; }
+inline constexpr bitboard shift_bwd(color c, bitboard b) noexcept
+{ return c == BLACK ? b >> 8 : b << 8; }
+
+// Moves every square to the adjacent file (squares falling off the board are
+// discarded).
+inline constexpr bitboard shift_east(bitboard b) noexcept
+{ return (b << 1) & ~FILE_A_BB; }
+inline constexpr bitboard shift_west(bitboard b) noexcept
+{ return (b >> 1) & ~FILE_H_BB; }
+
+// Adds to the set every square in front of / behind the set itself from the
+// point of view of color `c`.
+inline constexpr bitboard fill_fwd(color c, bitboard b) noexcept
+{
+  if (c == BLACK)
+  {
+    b |= b << 8;
+    b |= b << 16;
+    b |= b << 32;
+  }
+  else
+  {
+    b |= b >> 8;
+    b |= b >> 16;
+    b |= b >> 32;
+  }
+
+  return b;
+}
+inline constexpr bitboard fill_bwd(color c, bitboard b) noexcept
+{ return fill_fwd(!c, b); }
+
+}  // namespace testudo
+
+#endif  // include guard
@@ -8,35 +8,388 @@
  *  You can obtain one at http://mozilla.org/MPL/2.0/
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
 
 #include "cache.h"
+#include "log.h"
 #include "search.h"
+#include "util.h"
 
 namespace testudo
 {
 
+namespace
+{
+
+// Minimum number of bytes cleared by a single thread: below this threshold
+// the cost of spawning a thread exceeds the saving.
+constexpr std::size_t CLEAR_CHUNK = 32 * 1024 * 1024;
+
+// Header of a transposition table file or shared memory segment. The header
+// is followed by the raw content of the table.
+// `version` must be increased every time the layout of the elements changes
+// in a way not detected by their size.
+struct table_header
+{
+  char          magic[8];
+  std::uint32_t version;
+  std::uint32_t element_size;
+  std::uint64_t elements;
+  hash_t        zobrist;
+  std::uint8_t  age;
+};
+
+constexpr char TABLE_MAGIC[8] = {'T', 'E', 'S', 'T', 'U', 'D', 'O', 'H'};
+constexpr std::uint32_t TABLE_VERSION = 2;
+
+// Header of a shared memory segment.
+struct shared_header
+{
+  table_header header;
+
+  std::atomic<std::uint32_t> ready;  // header and table are initialized
+  std::atomic<std::uint32_t>   age;  // current age (see `cache::inc_age`)
+};
+
+// Space reserved for the header. Keeps the table cache line aligned.
+constexpr std::size_t HEADER_SIZE = 64;
+static_assert(sizeof(shared_header) <= HEADER_SIZE, "Header too large");
+
+table_header make_header(std::size_t elements, std::size_t element_size,
+                         std::uint8_t age)
+{
+  table_header h{};
+  std::memcpy(h.magic, TABLE_MAGIC, sizeof(h.magic));
+  h.version      = TABLE_VERSION;
+  h.element_size = element_size;
+  h.elements     = elements;
+  h.zobrist      = zobrist::identity();
+  h.age          = age;
+
+  return h;
+}
+
+bool compatible(const table_header &h, std::size_t element_size)
+{
+  return std::memcmp(h.magic, TABLE_MAGIC, sizeof(h.magic)) == 0
+         && h.version == TABLE_VERSION
+         && h.element_size == element_size
+         && h.zobrist == zobrist::identity()
+         && h.elements && !(h.elements & (h.elements - 1));
+}
+
+// Value-initializes `n` objects starting at `first`.
+// Large blocks are split into contiguous chunks filled in parallel. For
+// memory not yet touched this is also the first write: on NUMA systems the
+// pages are placed on the nodes of the filling threads.
+template<class T>
+void parallel_fill(T *first, std::size_t n)
+{
+  parallel_for(n, 0, CLEAR_CHUNK / sizeof(T),
+               [first](unsigned, std::size_t from, std::size_t to)
+               {
+                 std::uninitialized_fill(first + from, first + to, T());
+               });
+}
+
+}  // unnamed namespace
+
 // Fills the slot with the given information. The procedure may keep some of
 // the existing information if they're about the same position.
 inline constexpr void cache::slot::save(hash_t h, move m, int d, score_type t,
                                         score v, std::uint8_t a) noexcept
 {
-  assert(std::numeric_limits<decltype(value_)>::min() <= v);
-  assert(v <= std::numeric_limits<decltype(value_)>::max());
+  assert(std::numeric_limits<std::int16_t>::min() <= v);
+  assert(v <= std::numeric_limits<std::int16_t>::max());
+  assert(0 <= d && d <= std::numeric_limits<std::int16_t>::max());
+  assert(m.flags < 0x200);
 
   // Preserve any existing move for the same position.
-  if (m || hash_ != h)
-    best_move_ = m;
+  if (!m && hash() == h)
+    m = best_move();
+
+  data_ = pack(m, d, t, v, a);
+  key_ = h ^ data_;
+}
+
+cache::cache(std::uint8_t bits)
+  : stats(), memory_(), shared_name_(), probe_(), tt_(nullptr), size_(0),
+    age_(0), shared_age_(nullptr)
+{
+  allocate(std::size_t(1) << bits);
+}
+
+cache::~cache()
+{
+  release();
+}
+
+// Releases the memory of the table. The last process detaching from a shared
+// table (the only one able to lock it exclusively) removes the shared memory
+// segment.
+void cache::release() noexcept
+{
+  if (shared())
+  {
+    if (memory_.try_lock_exclusive())
+      large_memory::remove_shared(shared_name_);
+
+    shared_name_.clear();
+  }
+
+  memory_ = large_memory();
+  tt_ = nullptr;
+  size_ = 0;
+  shared_age_ = nullptr;
+}
+
+// Allocates memory for `n` (power of 2) elements and clears the table.
+// If the size doesn't change the content is preserved (e.g. a table loaded
+// from file at startup survives the `memory` command sent by the GUI).
+// A shared table isn't resized: the size of the segment is fixed by its
+// creator and other processes are using it.
+void cache::allocate(std::size_t n)
+{
+  assert(n && !(n & (n - 1)));
+
+  if (shared())
+  {
+    if (n != size_)
+    {
+      testudoWARNING << "Shared hash table " << shared_name_
+                     << " cannot be resized";
+    }
+    return;
+  }
+
+  if (n == size_)
+    return;
 
-  hash_  = h;
-  draft_ = d;
-  value_ = v;
-  type_  = t;
-  age_   = a;
+  // Releases the old table before allocating the new one: keeping both could
+  // exceed the available memory.
+  release();
+
+  memory_ = large_memory(n * sizeof(element));
+  tt_ = static_cast<element *>(memory_.get());
+  size_ = n;
+
+  clear();
 }
 
-// Looks up a position in the cache. Returns pointer to a `slot` if the
-// position is found. Otherwise, returns `nullptr`.
+// Resizes the table so that it uses at most `mb` megabytes (the number of
+// elements must be a power of 2). Content of the table is lost unless the
+// size is unchanged. A shared table keeps its size (see `allocate`).
+// `mb` is limited to `MAX_MB`.
+void cache::size_mb(std::size_t mb)
+{
+  if (mb > MAX_MB)
+    mb = MAX_MB;
+
+  const std::size_t bytes(std::max<std::size_t>(mb, 1) * 1024 * 1024);
+
+  std::size_t n(1);
+  while (2 * n * sizeof(element) <= bytes)
+    n *= 2;
+
+  allocate(n);
+}
+
+std::size_t cache::size_mb() const noexcept
+{
+  return size_ * sizeof(element) / (1024 * 1024);
+}
+
+// Empties the table (the work is split among multiple threads, see
+// `parallel_fill`). Since `large_memory` doesn't touch the pages it maps,
+// this is also the first write to the table.
+// A shared table isn't cleared: other processes are using it.
+void cache::clear()
+{
+  if (!shared())
+  {
+    parallel_fill(tt_, size_);
+    age_ = 0;
+  }
+}
+
+// Starts a new search: entries stored by the previous ones become the first
+// candidates for replacement.
+// Processes sharing a table share the age too: the entries of a search in
+// progress in another process aren't considered old.
+void cache::inc_age() noexcept
+{
+  if (shared_age_)
+    shared_age_->fetch_add(1, std::memory_order_relaxed);
+  else
+    ++age_;
+}
+
+// Saves the content of the table to a file (see `load`).
+// Data is written to a temporary file which then replaces the old one: the
+// table could be mapped from the old file.
+bool cache::save(const std::string &file) const
+{
+  const auto h(make_header(size_, sizeof(element), current_age()));
+
+  const std::string tmp(file + ".tmp");
+
+  {
+    std::ofstream out(tmp, std::ios::binary);
+
+    char header[HEADER_SIZE] = {};
+    std::memcpy(header, &h, sizeof(h));
+
+    out.write(header, sizeof(header));
+    out.write(reinterpret_cast<const char *>(tt_), size_ * sizeof(element));
+
+    if (!out.flush())
+    {
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+
+  return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+// Replaces the table with the content of a file created by `save`. The size of
+// the table becomes the size stored in the file.
+// The file is mapped in memory (see `large_memory`) so loading is almost
+// instantaneous even for large tables.
+// Returns `false` (and leaves the table unchanged) if the file is missing or
+// incompatible (different version, element format or Zobrist keys).
+bool cache::load(const std::string &file)
+{
+  table_header h;
+
+  {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.read(reinterpret_cast<char *>(&h), sizeof(h)))
+      return false;
+  }
+
+  if (!compatible(h, sizeof(element)))
+    return false;
+
+  large_memory m;
+  try
+  {
+    m = large_memory(file);
+  }
+  catch (const std::runtime_error &)
+  {
+    return false;
+  }
+
+  if (m.size() < HEADER_SIZE + h.elements * sizeof(element))
+    return false;
+
+  release();
+
+  memory_ = std::move(m);
+  tt_ = reinterpret_cast<element *>(static_cast<char *>(memory_.get())
+                                    + HEADER_SIZE);
+  size_ = h.elements;
+  age_ = h.age;
+
+  return true;
+}
+
+// Moves the table to the POSIX shared memory segment `name` so that it's
+// used by multiple processes at the same time (the lockless format of the
+// slots detects corrupted information).
+// The first process creates the segment (with the current size of the table),
+// the others attach to it (adopting its size). Content of the current table
+// is lost.
+// Attaching and detaching are synchronized by file locks (see
+// `large_memory::shared`), which the kernel releases if a process crashes:
+// a segment isn't removed while in use and is removed when the last process
+// detaches. A segment whose creator died before initializing it is replaced.
+// Returns `false` (and leaves the table unchanged) if the segment cannot be
+// used (e.g. different version, element format or Zobrist keys).
+bool cache::share(std::string name)
+{
+  if (name.empty())
+    return false;
+  if (name.front() != '/')
+    name.insert(0, "/");
+
+  for (unsigned attempt(0); attempt < 2; ++attempt)
+  {
+    bool created;
+    large_memory m;
+    try
+    {
+      m = large_memory::shared(name, HEADER_SIZE + size_ * sizeof(element),
+                               &created);
+    }
+    catch (const std::runtime_error &)
+    {
+      return false;
+    }
+
+    auto *sh(static_cast<shared_header *>(m.get()));
+    auto *table(reinterpret_cast<element *>(static_cast<char *>(m.get())
+                                            + HEADER_SIZE));
+
+    if (created)
+    {
+      new (sh) shared_header();
+      sh->header = make_header(size_, sizeof(element), 0);
+      parallel_fill(table, size_);
+      sh->ready.store(1, std::memory_order_release);
+
+      if (!m.lock_shared())
+      {
+        large_memory::remove_shared(name);
+        return false;
+      }
+    }
+    else if (!sh->ready.load(std::memory_order_acquire))
+    {
+      // The creator held an exclusive lock until the end of the
+      // initialization: it died in the meantime.
+      if (m.try_lock_exclusive())
+      {
+        large_memory::remove_shared(name);
+        continue;
+      }
+
+      return false;
+    }
+
+    if (!compatible(sh->header, sizeof(element))
+        || m.size() < HEADER_SIZE + sh->header.elements * sizeof(element))
+      return false;
+
+    release();
+
+    memory_ = std::move(m);
+    shared_name_ = name;
+    tt_ = table;
+    size_ = sh->header.elements;
+    age_ = 0;
+    shared_age_ = &sh->age;
+
+    return true;
+  }
+
+  return false;
+}
+
+// Looks up a position in the cache. Returns pointer to a copy of the `slot`
+// if the position is found (valid until the next call). Otherwise, returns
+// `nullptr`.
+// Working on a copy, the information cannot change under our feet if the
+// table is concurrently updated (see `share`).
 // If available, we prefer the information of the always-replace slot.
 // The logic follows:
 // > Draft is a highly over-valued property of TT entries. Of course a hit on
@@ -59,17 +412,33 @@ const cache::slot *cache::find(hash_t h) noexcept
 {
   auto &elem(tt_[get_index(h)]);
 
-  if (elem.first.hash() == h)
+  if (stats_enabled)
+    ++stats.probes;
+
+  probe_ = elem.first;
+  if (probe_.hash() == h)
   {
+    if (stats_enabled)
+      ++stats.hits;
+
     // The replace-always slot doesn't use the age information.
-    // elem.first.age(age_);
-    return &elem.first;
+    return &probe_;
   }
 
-  if (elem.second.hash() == h)
+  probe_ = elem.second;
+  if (probe_.hash() == h)
   {
-    elem.second.age(age_);
-    return &elem.second;
+    if (stats_enabled)
+      ++stats.hits;
+
+    // Refreshes the age. Not for a shared table: writing back the copy
+    // could overwrite a newer entry stored by another process.
+    if (!shared())
+    {
+      probe_.age(age_);
+      elem.second = probe_;
+    }
+    return &probe_;
   }
 
   return nullptr;
@@ -99,51 +468,70 @@ const cache::slot *cache::find(hash_t h) noexcept
 // devised by Ken Thompson and Joe Condon): for each table entry there is a
 // always-replace and depth-preferred slot.
 void cache::insert(hash_t h, const move &m, int draft, score_type t,
-                   score v) noexcept
+                   score v, unsigned ply) noexcept
 {
   // Adjusts mate scores.
   // > Mate scores are weird because they change depending upon where in the
-  // > tree they are found.  When stored in the hash table, additional
-  // > weirdness can result. This problem can be solved by converting any mate
-  // > scores to bounds, then storing the bounds.
-  // > A few weird cases were mates that are failing low, and "-mates" that are
-  // > failing high. These are stored without any bound information, so it's
-  // > not possible to cut off on these later.
+  // > tree they are found.
   // (Bruce Moreland)
+  // Instead of converting mate scores to (weaker) bounds, they're stored
+  // relative to the current node: the score `-INF + ply` (mated at distance
+  // `ply` from the root) becomes `-INF` when saved at distance `ply` (mated
+  // here) and is converted back by `slot::value` according to the distance
+  // from the root of the probing node.
   if (v >= MATE)
-  {
-    if (t == score_type::fail_low)  // failing low on MATE
-      v = +INF;                     // don't allow a cutoff later
-    else
-    {
-      t = score_type::fail_high;    // exact/fail-high, turned into a fail-high
-      v = MATE;
-    }
-  }
+    v += ply;
   else if (v <= -MATE)
-  {
-    if (t == score_type::fail_high) // fail high on -MATE
-      v = -INF;                     // dont't allow cutoff later
-    else
-    {
-      t = score_type::fail_low;     // exact/fail-low, turned into a fail-low
-      v = -MATE;
-    }
-  }
+    v -= ply;
 
   auto &elem(tt_[get_index(h)]);
+  const auto age(current_age());
+
+  // Empty slots have a zero key.
+  const auto count([this, h](const slot &s, std::uintmax_t *overwrites)
+                   {
+                     if (s.hash() == h)
+                       ++stats.same_key;
+                     else if (s.hash())
+                       ++*overwrites;
+                   });
 
   // Always replace slot.
-  elem.first.save(h, m, draft, t, v, age_);
+  if (stats_enabled)
+    count(elem.first, &stats.always_replace);
+  elem.first.save(h, m, draft, t, v, age);
 
   // Depth preferred slot.
   // Here, using a "replace if deeper or same depth" scheme, the cache might
   // eventually fill up with outdated deep nodes. The solution to this is add a
   // "age" field to the slot, so the replacement scheme becomes: "replace if
   // same depth, deeper or the element pertains to an ancient search".
-  if (elem.second.age() != age_
+  if (elem.second.age() != age
       || elem.second.draft() <= draft)
-    elem.second.save(h, m, draft, t, v, age_);
+  {
+    if (stats_enabled)
+      count(elem.second, &stats.depth_preferred);
+    elem.second.save(h, m, draft, t, v, age);
+  }
+}
+
+// Returns the per-mille of slots used by the current search (i.e. having the
+// current age). The figure is estimated on the first elements of the table.
+unsigned cache::hashfull() const noexcept
+{
+  const std::size_t sample(std::min<std::size_t>(size_, 500));
+  const auto age(current_age());
+
+  unsigned used(0);
+  for (std::size_t i(0); i < sample; ++i)
+  {
+    const auto &elem(tt_[i]);
+
+    used += elem.first.hash() && elem.first.age() == age;
+    used += elem.second.hash() && elem.second.age() == age;
+  }
+
+  return used * 1000 / (2 * sample);
 }
 
 }  // namespace testudo
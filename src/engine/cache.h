@@ -11,9 +11,16 @@
 #if !defined(TESTUDO_CACHE_H)
 #define      TESTUDO_CACHE_H
 
-#include <vector>
+#include <atomic>
+#include <string>
+#include <utility>
+
+#if defined(_MSC_VER)
+#  include <xmmintrin.h>
+#endif
 
 #include "move.h"
+#include "nonstd.h"
 #include "zobrist.h"
 
 namespace testudo
@@ -45,51 +52,190 @@ enum class score_type : std::uint8_t
 class cache
 {
 public:
+  // A slot is made of two 64 bit words: the data word packing the
+  // information about the position and the key word (the hash key XOR the
+  // data word).
+  // This is the "lockless" format (Robert Hyatt, Tim Mann): when more
+  // writers (e.g. processes sharing the table) interleave their updates, the
+  // slot may end up with the key of a position and the data of another one.
+  // The XOR makes such corrupted slots very unlikely to match any key, so
+  // they're simply ignored.
   class slot
   {
   public:
     constexpr slot() noexcept
-    : hash_(0), best_move_(move::sentry()), draft_(0), value_(+INF),
-      type_(score_type::fail_low), age_(0)
+      : key_(pack(move::sentry(), 0, score_type::fail_low, +INF, 0)),
+        data_(key_)
     {
     }
 
     constexpr void save(hash_t, move, int, score_type, score,
                         std::uint8_t) noexcept;
 
-    constexpr const hash_t &hash() const noexcept { return hash_; }
-    constexpr const move &best_move() const noexcept { return best_move_; }
-    constexpr int draft() const noexcept { return draft_; }
-    constexpr score_type type() const noexcept { return type_; }
-    constexpr score value() const noexcept { return value_; }
-    constexpr std::uint8_t age() const noexcept { return age_; }
+    constexpr hash_t hash() const noexcept { return key_ ^ data_; }
+    constexpr move best_move() const noexcept;
+    constexpr int draft() const noexcept
+    { return static_cast<std::int16_t>(data_ >> 48); }
+    constexpr score_type type() const noexcept
+    { return static_cast<score_type>((data_ >> 21) & 3); }
+    constexpr score value(unsigned = 0) const noexcept;
+    constexpr std::uint8_t age() const noexcept
+    { return static_cast<std::uint8_t>(data_ >> 23); }
 
-    void age(std::uint8_t a) noexcept { age_ = a; }
+    constexpr void age(std::uint8_t) noexcept;
 
   private:
-    hash_t        hash_;
-    move     best_move_;
-    int          draft_;
-    std::int16_t value_;
-    score_type    type_;
-    std::uint8_t   age_;
+    // Layout of the data word:
+    // - bits  0-20: best move (from, to and flags);
+    // - bits 21-22: score type;
+    // - bits 23-30: age;
+    // - bits 32-47: value;
+    // - bits 48-63: draft.
+    static constexpr std::uint64_t pack(move, int, score_type, score,
+                                        std::uint8_t) noexcept;
+
+    hash_t          key_;
+    std::uint64_t  data_;
+  };
+
+  // Counters describing the use of the table. They're updated only if the
+  // `TESTUDO_TT_STATS` macro is defined.
+  struct statistics
+  {
+    statistics() : probes(0), hits(0), cutoffs(0), always_replace(0),
+                   depth_preferred(0), same_key(0) {}
+    void reset() { *this = statistics(); }
+
+    std::uintmax_t          probes;  // calls to `find`
+    std::uintmax_t            hits;  // probes finding the position
+    std::uintmax_t         cutoffs;  // hits directly returning a score
+    std::uintmax_t  always_replace;  // another position overwritten
+    std::uintmax_t depth_preferred;  // ditto for the depth-preferred slot
+    std::uintmax_t        same_key;  // slots updated for the same position
   };
 
-  explicit cache(std::uint8_t bits = 19) : tt_(1 << bits), age_(0) {}
+#if defined(TESTUDO_TT_STATS)
+  static constexpr bool stats_enabled = true;
+#else
+  static constexpr bool stats_enabled = false;
+#endif
+
+  // Largest size of the table accepted by `size_mb` (megabytes).
+  static constexpr std::size_t MAX_MB =
+    std::size_t(1) << (sizeof(std::size_t) > 4 ? 20 : 10);
+
+  explicit cache(std::uint8_t bits = 19);
+  ~cache();
+
+  // Size of the table in megabytes.
+  std::size_t size_mb() const noexcept;
+  void size_mb(std::size_t);
+
+  void clear();
+
+  bool save(const std::string &) const;
+  bool load(const std::string &);
+
+  bool share(std::string);
+  bool shared() const noexcept { return !shared_name_.empty(); }
 
   const slot *find(hash_t) noexcept;
-  void insert(hash_t, const move &, int, score_type, score) noexcept;
+  void cutoff() noexcept { if (stats_enabled) ++stats.cutoffs; }
+  void prefetch(hash_t) const noexcept;
+  void insert(hash_t, const move &, int, score_type, score,
+              unsigned = 0) noexcept;
 
-  void inc_age() { ++age_; }
+  void inc_age() noexcept;
+  unsigned hashfull() const noexcept;
+
+  statistics stats;
 
 private:
-  std::size_t get_index(hash_t h) const noexcept
-  { return h & (tt_.size() - 1); }
+  using element = std::pair<slot, slot>;
+
+  void allocate(std::size_t);
+  void release() noexcept;
+
+  std::size_t get_index(hash_t h) const noexcept { return h & (size_ - 1); }
+  std::uint8_t current_age() const noexcept;
+
+  large_memory memory_;
+  std::string shared_name_;  // empty for a private table
+  slot probe_;  // copy of the last slot found (see `find`)
+  element *tt_;
+  std::size_t size_;  // number of elements (power of 2)
 
-  std::vector<std::pair<slot, slot>> tt_;
   decltype(slot().age()) age_;
+  std::atomic<std::uint32_t> *shared_age_;  // age of a shared table
 };
 
+// The age of a shared table is common to all the processes (see `share`).
+inline std::uint8_t cache::current_age() const noexcept
+{
+  return shared_age_
+         ? static_cast<std::uint8_t>(
+             shared_age_->load(std::memory_order_relaxed))
+         : age_;
+}
+
+// Asks the CPU to start loading the table element for the given hash key.
+// The element is typically a cache miss: calling this function as soon as the
+// key is known (e.g. just after selecting a move) hides the memory latency
+// behind other work (e.g. making the move).
+inline void cache::prefetch(hash_t h) const noexcept
+{
+#if defined(__GNUC__)
+  __builtin_prefetch(&tt_[get_index(h)]);
+#elif defined(_MSC_VER)
+  _mm_prefetch(reinterpret_cast<const char *>(&tt_[get_index(h)]),
+               _MM_HINT_T0);
+#else
+  (void)h;
+#endif
+}
+
+// Mate scores are stored relative to the node (i.e. as distance to mate from
+// the node and not from the root): the same position can be reached at
+// different distances from the root.
+// `ply` is the distance of the node from the root and the function returns the
+// value relative to the root.
+inline constexpr score cache::slot::value(unsigned ply) const noexcept
+{
+  const score v(static_cast<std::int16_t>(data_ >> 32));
+
+  return v >= MATE ? v - static_cast<score>(ply)
+         : v <= -MATE ? v + static_cast<score>(ply)
+         : v;
+}
+
+inline constexpr move cache::slot::best_move() const noexcept
+{
+  return move(static_cast<square>(data_ & 63),
+              static_cast<square>((data_ >> 6) & 63),
+              static_cast<move::flags_t>((data_ >> 12) & 0x1FF));
+}
+
+inline constexpr void cache::slot::age(std::uint8_t a) noexcept
+{
+  const hash_t h(hash());
+
+  data_ = (data_ & ~(std::uint64_t(0xFF) << 23)) | std::uint64_t(a) << 23;
+  key_ = h ^ data_;
+}
+
+inline constexpr std::uint64_t cache::slot::pack(move m, int d, score_type t,
+                                                 score v,
+                                                 std::uint8_t a) noexcept
+{
+  return std::uint64_t(m.from)
+         | std::uint64_t(m.to) << 6
+         | std::uint64_t(m.flags) << 12
+         | std::uint64_t(t) << 21
+         | std::uint64_t(a) << 23
+         | std::uint64_t(static_cast<std::uint16_t>(v)) << 32
+         | std::uint64_t(static_cast<std::uint16_t>(d)) << 48;
+}
+
 }  // namespace testudo
 
 #endif  // include guard
@@ -74,11 +74,34 @@ std::chrono::seconds xboard_time(const std::string &s)
   return std::chrono::seconds(seconds);
 }
 
-void loop()
+// `hash_mb` is the size (megabytes) of the hash table (`0` for the default
+// size).
+// `hash_file` (optional) is the default file for the `savehash` / `loadhash`
+// commands: if it exists it's loaded at startup and it's updated on exit.
+// `shared_hash` (optional) is the name of a shared memory segment containing
+// a hash table used by cooperating processes.
+void loop(std::size_t hash_mb, const std::string &hash_file,
+          const std::string &shared_hash)
 {
   using namespace std::chrono_literals;
 
   game g;
+  if (hash_mb)
+    g.hash_size(hash_mb);
+
+  if (!hash_file.empty() && g.load_hash(hash_file))
+  {
+    testudoINFO << "Hash table loaded from " << hash_file;
+  }
+
+  if (!shared_hash.empty())
+  {
+    if (g.share_hash(shared_hash))
+      testudoINFO << "Using shared hash table " << shared_hash;
+    else
+      testudoINFO << "Cannot use shared hash table " << shared_hash;
+  }
+
   bool analyze_mode(false);
 
   for (;;)
@@ -118,6 +141,16 @@ void loop()
       analyze_mode = true;
       continue;
     }
+    if (cmd == "egtpath")
+    {
+      std::string type, path;  is >> type >> std::ws;  std::getline(is, path);
+      if (type == "testudo")
+      {
+        testudoINFO << "Loaded " << tablebase::init(path)
+                    << " endgame tables from " << path;
+      }
+      continue;
+    }
     if (cmd == "exit")
     {
       analyze_mode = false;
@@ -150,6 +183,15 @@ void loop()
       testudoINFO << "Setting ICS server to: " << g.ics;
       continue;
     }
+    if (cmd == "loadhash")
+    {
+      std::string file(hash_file);  is >> file;
+      if (g.load_hash(file))
+        testudoINFO << "Hash table loaded from " << file;
+      else
+        testudoOUTPUT << "Error (cannot load hash file): " << file;
+      continue;
+    }
     if (cmd == "level")
     {
       unsigned    moves;  is >> moves;
@@ -169,11 +211,22 @@ void loop()
       g.level(moves, time);
       continue;
     }
+    if (cmd == "memory")
+    {
+      long mb(0);
+      if (is >> mb && mb > 0)
+      {
+        testudoINFO << "Setting hash table size to " << mb << "MB";
+        g.hash_size(mb);
+      }
+      else
+        testudoOUTPUT << "Error (invalid size): memory";
+      continue;
+    }
     if (cmd == "new")
     {
-      g = decltype(g)();
+      g.new_game();
       g.computer_side(BLACK);
-      g.max_depth(0);
       continue;
     }
     if (cmd == "nopost")
@@ -185,7 +238,8 @@ void loop()
     {
       int version;  is >> version;  // skips version
       testudoOUTPUT << "feature myname=\"TESTUDO 0.9\" playother=1 sigint=0 "
-                       "colors=0 setboard=1 ics=1 debug=1 done=1";
+                       "colors=0 setboard=1 ics=1 debug=1 memory=1 "
+                       "egt=\"testudo\" done=1";
       continue;
     }
     if (cmd == "playother")
@@ -199,7 +253,13 @@ void loop()
       continue;
     }
     if (cmd == "quit")
+    {
+      if (!hash_file.empty() && !g.save_hash(hash_file))
+      {
+        testudoINFO << "Cannot save hash table to " << hash_file;
+      }
       return;
+    }
     if (cmd == "remove")
     {
       g.take_back(2);
@@ -210,6 +270,15 @@ void loop()
       g.computer_side(-1);
       continue;
     }
+    if (cmd == "savehash")
+    {
+      std::string file(hash_file);  is >> file;
+      if (g.save_hash(file))
+        testudoINFO << "Hash table saved to " << file;
+      else
+        testudoOUTPUT << "Error (cannot save hash file): " << file;
+      continue;
+    }
     if (cmd == "setboard")
     {
       std::string fen;  is >> fen;
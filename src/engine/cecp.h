@@ -11,6 +11,9 @@
 #if !defined(TESTUDO_CECP_H)
 #define      TESTUDO_CECP_H
 
+#include <cstddef>
+#include <string>
+
 namespace testudo
 {
 
@@ -18,7 +21,8 @@ namespace testudo
 namespace CECP
 {
 
-void loop();
+void loop(std::size_t = 0, const std::string & = "",
+          const std::string & = "");
 
 }  // namespace CECP
 
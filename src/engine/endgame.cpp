@@ -0,0 +1,284 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+#include "endgame.h"
+#include "kpk.h"
+#include "material.h"
+
+namespace testudo
+{
+
+namespace endgame
+{
+
+namespace
+{
+
+// Bonus for driving the weak king towards the edge of the board.
+score push_to_edge(square sq)
+{
+  const int f(file(sq)), r(rank(sq));
+  return 20 * (std::max(3 - f, f - 4) + std::max(3 - r, r - 4));
+}
+
+// Bonus for keeping the kings close (the strong king has to help).
+score push_close(square s1, square s2)
+{
+  return 140 - 20 * static_cast<score>(distance(s1, s2));
+}
+
+// Non-pawn material.
+score npm(const state &s, color c)
+{
+  score ret(0);
+
+  for (auto t : {piece::knight, piece::bishop, piece::rook, piece::queen})
+    ret += int(s.piece_count(c, t)) * piece(c, t).value();
+
+  return ret;
+}
+
+score material(const state &s, color c)
+{
+  return npm(s, c)
+         + int(s.piece_count(c, piece::pawn)) * piece(c, piece::pawn).value();
+}
+
+unsigned pieces_count(const state &s, color c)
+{
+  return s.piece_count(c, piece::knight) + s.piece_count(c, piece::bishop)
+         + s.piece_count(c, piece::rook) + s.piece_count(c, piece::queen);
+}
+
+bool bare_king(const state &s, color c)
+{
+  return !pieces_count(s, c) && !s.piece_count(c, piece::pawn);
+}
+
+// Mating material against a bare king. The value leads the search towards
+// the mating net: weak king on the edge, kings close.
+score kxk(const state &s, color strong)
+{
+  assert(bare_king(s, !strong));
+
+  const square wk(s.king_square(!strong)), sk(s.king_square(strong));
+  const bitboard bishops(s.pieces(strong, piece::bishop));
+
+  score v(material(s, strong) + push_to_edge(wk) + push_close(sk, wk));
+
+  if (s.piece_count(strong, piece::queen) || s.piece_count(strong, piece::rook)
+      || (bishops && s.piece_count(strong, piece::knight))
+      || ((bishops & DARK_SQUARES_BB) && (bishops & ~DARK_SQUARES_BB)))
+    v += KNOWN_WIN;
+
+  return s.side() == strong ? v : -v;
+}
+
+// Bishop and knight against a bare king: mate is possible only in a corner
+// of the colour of the bishop, so the weak king is driven there.
+score kbnk(const state &s, color strong)
+{
+  const square wk(s.king_square(!strong)), sk(s.king_square(strong));
+  const bool dark(s.pieces(strong, piece::bishop) & DARK_SQUARES_BB);
+
+  const auto manhattan([](square s1, square s2)
+                       {
+                         const int df(int(file(s1)) - int(file(s2)));
+                         const int dr(int(rank(s1)) - int(rank(s2)));
+                         return std::abs(df) + std::abs(dr);
+                       });
+
+  const int corner(dark ? std::min(manhattan(wk, A1), manhattan(wk, H8))
+                        : std::min(manhattan(wk, A8), manhattan(wk, H1)));
+
+  const score v(KNOWN_WIN + material(s, strong) + push_close(sk, wk)
+                + 20 * (14 - corner));
+
+  return s.side() == strong ? v : -v;
+}
+
+// Promotion square of a pawn of color `c` on square `sq`.
+square promotion_square(color c, square sq)
+{
+  return to_square(file(sq), c == WHITE ? 7 : 0);
+}
+
+// King and pawn against king: the exact result comes from the bitbase (see
+// `kpk::probe`). Won positions get a bonus for the advancement of the pawn.
+score kpk(const state &s, color strong)
+{
+  // The bitbase uses White's point of view.
+  const auto normalize([strong](square sq)
+                       {
+                         return strong == WHITE ? sq : flip(sq);
+                       });
+
+  const square wp(normalize(lsb(s.pieces(strong, piece::pawn))));
+
+  if (!testudo::kpk::probe(normalize(s.king_square(strong)), wp,
+                           normalize(s.king_square(!strong)),
+                           s.side() == strong ? WHITE : BLACK))
+    return 0;
+
+  const score v(KNOWN_WIN + piece(strong, piece::pawn).value()
+                + 10 * static_cast<score>(rank(wp)));
+
+  return s.side() == strong ? v : -v;
+}
+
+// Bishop and pawns:
+// - rook pawns with the "wrong" bishop (not controlling the promotion
+//   square) can't win if the weak king reaches the corner;
+// - bishops of opposite colours (and nothing else) are very drawish.
+unsigned bishop_pawns(const state &s, color strong)
+{
+  const bitboard pawns(s.pieces(strong, piece::pawn));
+  const bitboard bishop(s.pieces(strong, piece::bishop));
+
+  for (const bitboard rook_file : {FILE_A_BB, FILE_H_BB})
+    if (pawns && !(pawns & ~rook_file))
+    {
+      const square promotion(promotion_square(strong, lsb(pawns)));
+      const bool same_colour(!(bishop & DARK_SQUARES_BB)
+                             == !(bb(promotion) & DARK_SQUARES_BB));
+
+      if (!same_colour
+          && distance(s.king_square(!strong), promotion) <= 1)
+        return 0;
+    }
+
+  const bitboard xbishop(s.pieces(!strong, piece::bishop));
+  if (xbishop && pieces_count(s, !strong) == 1
+      && !(bishop & DARK_SQUARES_BB) != !(xbishop & DARK_SQUARES_BB))
+  {
+    const int diff(int(popcount(pawns))
+                   - int(popcount(s.pieces(!strong, piece::pawn))));
+    return diff <= 1 ? material_entry::SCALE_NORMAL / 4
+                     : material_entry::SCALE_NORMAL / 2;
+  }
+
+  return SCALE_NONE;
+}
+
+// Specialised functions for specific material configurations.
+class registry
+{
+public:
+  registry();
+
+  const functions *find(hash_t key) const
+  {
+    const auto it(map_.find(key));
+    return it == map_.end() ? nullptr : &it->second;
+  }
+
+private:
+  void add(const std::string &, value_fn, bool = false);
+
+  static hash_t key(const std::string &, color);
+
+  std::unordered_map<hash_t, functions> map_;
+};
+
+registry::registry()
+{
+  add("KBNK", kbnk);
+  add("KPK", kpk, true);
+}
+
+// Material key (see `zobrist::material_hash`) of the configuration described
+// by `code`: the pieces of the strong side (color `strong`) and then the
+// pieces of the weak side, kings included (e.g. "KBNK").
+hash_t registry::key(const std::string &code, color strong)
+{
+  assert(code.size() >= 2 && code.front() == 'K');
+
+  const auto weak_king(code.find('K', 1));
+  assert(weak_king != std::string::npos);
+
+  unsigned count[2][6] = {};
+  hash_t ret(0);
+
+  for (std::size_t i(1); i < code.size(); ++i)
+  {
+    if (i == weak_king)
+      continue;
+
+    const color c(i < weak_king ? strong : !strong);
+
+    enum piece::type t;
+    switch (code[i])
+    {
+    case 'P':  t = piece::pawn;    break;
+    case 'N':  t = piece::knight;  break;
+    case 'B':  t = piece::bishop;  break;
+    case 'R':  t = piece::rook;    break;
+    default:   assert(code[i] == 'Q');  t = piece::queen;
+    }
+
+    ret ^= zobrist::piece[piece(c, t).id()][count[c][t]++];
+  }
+
+  return ret;
+}
+
+void registry::add(const std::string &code, value_fn f, bool exact_draws)
+{
+  for (color c : {BLACK, WHITE})
+  {
+    functions &e(map_[key(code, c)]);
+    e.value = f;
+    e.strong = c;
+    e.exact_draws = exact_draws;
+  }
+}
+
+}  // unnamed namespace
+
+// Specialised functions for the material configuration of `s`: the ones
+// registered for the specific material key or, failing that, the ones for
+// the class of configurations `s` belongs to.
+functions lookup(const state &s)
+{
+  // Function-local: built after the Zobrist keys (which are initialised in
+  // another translation unit).
+  static const registry db;
+
+  if (const auto *f = db.find(s.material_key()))
+    return *f;
+
+  functions ret;
+
+  for (color c : {BLACK, WHITE})
+  {
+    // Knights alone cannot force mate.
+    if (bare_king(s, !c) && npm(s, c) >= piece(c, piece::rook).value()
+        && s.piece_count(c, piece::knight) < pieces_count(s, c))
+    {
+      ret.value = kxk;
+      ret.strong = c;
+      return ret;
+    }
+
+    if (s.piece_count(c, piece::bishop) == 1 && pieces_count(s, c) == 1
+        && s.piece_count(c, piece::pawn))
+      ret.scale[c] = bishop_pawns;
+  }
+
+  return ret;
+}
+
+}  // namespace endgame
+
+}  // namespace testudo
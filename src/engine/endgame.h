@@ -0,0 +1,69 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_ENDGAME_H)
+#define      TESTUDO_ENDGAME_H
+
+#include "state.h"
+
+namespace testudo
+{
+
+// Bonus of the positions recognized as won (see `endgame::value_fn`). It's
+// larger than any positional advantage and far from the mate scores.
+constexpr score KNOWN_WIN = 10000;
+
+// Specialised knowledge for endgames whose general evaluation is misleading:
+// trivial wins requiring a precise technique (the general evaluation gives
+// no clue about how to drive the enemy king into a mating net), drawish
+// configurations depending on the position of the pieces...
+//
+// Functions are looked up by material configuration (see
+// `state::material_key`) when an entry of the material table is filled, so
+// positions without specialised knowledge don't pay for it.
+namespace endgame
+{
+
+// Evaluation of a position (side to move point of view) given the strong
+// side.
+using value_fn = score (*)(const state &, color);
+
+// End-game scale factor (see `material_entry::scale`) of the strong side.
+// Unlike the scale factors of the material table it can depend on the
+// position of the pieces. `SCALE_NONE` means "no specific knowledge".
+using scale_fn = unsigned (*)(const state &, color);
+
+constexpr unsigned SCALE_NONE = 255;
+
+struct functions
+{
+  // When `value` is set the position is evaluated only by `value(s, strong)`.
+  value_fn value = nullptr;
+  color strong = WHITE;
+
+  // When set, a zero `value` is a proven draw (e.g. from a bitbase) and the
+  // search doesn't need to go further.
+  bool exact_draws = false;
+
+  scale_fn scale[2] = {nullptr, nullptr};  // indexed by the strong side
+};
+
+functions lookup(const state &);
+
+inline bool proven_draw(const state &s, const functions &f)
+{
+  return f.exact_draws && !f.value(s, f.strong);
+}
+
+}  // namespace endgame
+
+}  // namespace testudo
+
+#endif  // include guard
@@ -8,16 +8,89 @@
  *  You can obtain one at http://mozilla.org/MPL/2.0/
  */
 
+#include <algorithm>
+#include <vector>
+
 #include "eval.h"
+#include "attacks.h"
+#include "bitboard.h"
+#include "features.h"
+#include "nnue.h"
 #include "parameters.h"
+#include "util.h"
 
 namespace testudo
 {
 
-void eval_king_shield(const state &s, score_vector &e)
+namespace
+{
+
+// Evaluation terms are sent to a "sink": `score_sink` sums them into a
+// `score_vector`, `feature_sink` records them as features (see `features`).
+// Both sinks are fed by the same code, so `features` is consistent with
+// `eval` by construction.
+class score_sink
+{
+public:
+  explicit score_sink(score_vector &e) : e_(e) {}
+
+  void pawn(color c, unsigned, int n, packed_score w) { e_.pawns[c] += w * n; }
+
+  void shield(color c, int n1, int n2, score w1, score w2)
+  { e_.king_shield[c] = (n1 * w1 + n2 * w2) / 2; }
+
+  void mobility(color c, unsigned, int n, packed_score w)
+  { e_.mobility[c] += w * n; }
+
+  void king_attack(color c, unsigned, int n, score w)
+  { e_.king_attack[c] += w * n; }
+
+private:
+  score_vector &e_;
+};
+
+class feature_sink
+{
+public:
+  feature_sink(color stm, int *counts) : stm_(stm), counts_(counts) {}
+
+  void add(color c, unsigned id, int n)
+  { counts_[id] += c == stm_ ? n : -n; }
+
+  void pawn(color c, unsigned id, int n, packed_score) { add(c, id, n); }
+  void mobility(color c, unsigned id, int n, packed_score) { add(c, id, n); }
+  void king_attack(color c, unsigned id, int n, score) { add(c, id, n); }
+
+  void shield(color c, int n1, int n2, score, score)
+  {
+    counts_[c == stm_ ? SHIELD1_US_FEATURE : SHIELD1_THEM_FEATURE] += n1;
+    counts_[c == stm_ ? SHIELD2_US_FEATURE : SHIELD2_THEM_FEATURE] += n2;
+  }
+
+private:
+  color stm_;
+  int *counts_;
+};
+
+// Number of pawns sheltering a king (`n1` one step ahead, `n2` two steps
+// ahead).
+struct shelter
+{
+  score bonus(const parameters &p) const
+  { return n1 * p.pawn_shield1() + n2 * p.pawn_shield2(); }
+
+  int n1, n2;
+};
+
+}  // unnamed namespace
+
+template<class P, class S>
+void eval_king_shield(const state &s, const P &src, S &sink)
 {
+  const parameters &p(values(src));
+
   const auto shelter_file(
-    [&s](color c, square sq)
+    [&s](color c, square sq, shelter &sh)
     {
       assert(valid(sq));
 
@@ -25,13 +98,14 @@ void eval_king_shield(const state &s, score_vector &e)
 
       assert(valid(sq + step_fwd(c)));
       if (s[sq + step_fwd(c)] == pawn)
-        return db.pawn_shield1();
+      {
+        ++sh.n1;
+        return;
+      }
 
       assert(valid(sq + 2 * step_fwd(c)));
       if (s[sq + 2 * step_fwd(c)] == pawn)
-        return db.pawn_shield2();
-
-      return 0;
+        ++sh.n2;
     });
 
   const auto shelter_square(
@@ -39,25 +113,25 @@ void eval_king_shield(const state &s, score_vector &e)
     {
       assert(valid(sq));
 
+      shelter ret{0, 0};
+
       const auto r(rank(sq));
       if (r == first_rank(c) || r == second_rank(c))
       {
-        score ret(shelter_file(c, sq));
+        shelter_file(c, sq, ret);
         if (file(sq) > FILE_A)
-          ret += shelter_file(c, sq - 1);
+          shelter_file(c, sq - 1, ret);
         if (file(sq) < FILE_H)
-          ret += shelter_file(c, sq + 1);
-
-        return ret;
+          shelter_file(c, sq + 1, ret);
       }
 
-      return 0;
+      return ret;
     });
 
   for (unsigned c(0); c < 2; ++c)
   {
-    const score bonus_here(shelter_square(c, s.king_square(c)));
-    score bonus_castle(bonus_here);
+    const shelter here(shelter_square(c, s.king_square(c)));
+    shelter castle(here);
 
     // If castling is:
     // - favourable, take the average of the current position and the after
@@ -66,283 +140,401 @@ void eval_king_shield(const state &s, score_vector &e)
 
     if (s.kingside_castle(c))
     {
-      const score tmp(shelter_square(c, c == WHITE ? G1 : G8));
-      if (tmp > bonus_castle)
-        bonus_castle = tmp;
+      const shelter tmp(shelter_square(c, c == WHITE ? G1 : G8));
+      if (tmp.bonus(p) > castle.bonus(p))
+        castle = tmp;
     }
     if (s.queenside_castle(c))
     {
-      const score tmp(shelter_square(c, c == WHITE ? B1 : B8));
-      if (tmp > bonus_castle)
-        bonus_castle = tmp;
+      const shelter tmp(shelter_square(c, c == WHITE ? B1 : B8));
+      if (tmp.bonus(p) > castle.bonus(p))
+        castle = tmp;
     }
 
-    e.king_shield[c] = (bonus_here + bonus_castle) / 2;
+    sink.shield(c, here.n1 + castle.n1, here.n2 + castle.n2,
+                p.pawn_shield1(), p.pawn_shield2());
   }
 }
 
-void eval_pawn_e(const state &s, square i, score_vector &e)
+// Pawn structure of color `c` (`pawns` / `xpawns` are the sets of friendly /
+// enemy pawns). Features are computed for all the pawns at once via set-wise
+// operations and the `parameters` tables are applied via popcounts.
+template<class P, class S>
+void eval_pawns(const state &s, color c, bitboard pawns, bitboard xpawns,
+                const P &src, S &sink)
 {
-  assert(s[i].type() == piece::pawn);
-  const color c(s[i].color());
-  const piece pawn(s[i]), xpawn(!c, piece::pawn);
+  const parameters &p(values(src));
 
-  e.pcsq_e[c] += db.pcsq_e(pawn, i);
+  // Squares strictly behind the given ones.
+  const auto behind([c](bitboard b) { return fill_bwd(c, shift_bwd(c, b)); });
 
-  bool is_passed(  true);  // we will be trying to disprove that
-  bool is_opposed(false);
+  const bitboard neighbours(shift_east(pawns) | shift_west(pawns));
 
-  // The loop below detects doubled pawns, passed pawns and sets a flag on
-  // finding that our pawn is opposed by enemy pawn.
-  for (square sq(i + step_fwd(c)); rank(c, sq) < 7; sq += step_fwd(c))
-  {
-    if (s[sq].type() == piece::pawn)
-    {
-      is_passed = false;
+  // Pawns opposed by an enemy pawn / followed by any pawn on the same file.
+  const bitboard opposed(pawns & behind(xpawns));
+  const bitboard blocked(pawns & behind(pawns | xpawns));
 
-      if (s[sq] == pawn)
-        e.pawns_e[c] += db.pawn_doubled_e();
-      else
-      {
-        assert(s[sq] == xpawn);
-        is_opposed = true;
-        break;
-      }
-    }
+  const bitboard passed(
+    pawns & ~blocked & ~behind(shift_east(xpawns) | shift_west(xpawns)));
 
-    if (file(sq) > FILE_A && s[sq - 1] == xpawn)
-      is_passed = false;
-    else if (file(sq) < FILE_H && s[sq + 1] == xpawn)
-      is_passed = false;
-  }
+  // Isolated and/or backward pawns: no friendly pawn on the adjacent files,
+  // on the same rank or behind.
+  const bitboard weak(pawns & ~fill_fwd(c, neighbours));
 
-  // Isolated and/or backward pawn.
-  bool is_weak(true);  // we will be trying to disprove that
+  // Passed pawns protected or supported by a friendly pawn.
+  const bitboard supported(neighbours | shift_fwd(c, neighbours));
 
-  // Going backwards and checking whether pawn has support.
-  unsigned steps(0);
-  for (square sq(i); rank(c, sq); sq -= step_fwd(c), ++steps)
-  {
-    if (file(sq) > FILE_A && s[sq - 1] == pawn)
-    {
-      is_weak = false;
-      break;
-    }
-    if (file(sq) < FILE_H && s[sq + 1] == pawn)
+  // Every couple of pawns on the same file (not separated by an enemy pawn)
+  // counts as doubled: `b` holds the squares reached moving forward `k` steps
+  // from friendly pawns without crossing enemy pawns.
+  int doubled(0);
+  for (bitboard b(shift_fwd(c, pawns) & ~xpawns); b;
+       b = shift_fwd(c, b) & ~xpawns)
+    doubled += popcount(b & pawns);
+
+  sink.pawn(c, DOUBLED_FEATURE, doubled, p.pawn_doubled());
+
+  // In the endgame we score passed pawns higher if they are protected or if
+  // their advance is supported by friendly pawns.
+  if (passed)
+    for (unsigned r(1); r < 7; ++r)
     {
-      is_weak = false;
-      break;
+      const bitboard on_rank(passed & rank_bb(c, r));
+      const int n(popcount(on_rank));
+      const int n_supported(popcount(on_rank & supported));
+
+      sink.pawn(c, PROTECTED_PASSED_FEATURE + r, n_supported,
+                p.pawn_protected_passed(r));
+      sink.pawn(c, PASSED_FEATURE + r, n - n_supported, p.pawn_passed(r));
     }
-  }
 
-  if (is_passed)
+  // In the middle-game a weak pawn is worse on a half-open file. In the
+  // endgame only if the enemy has heavy pieces to attack it.
+  if (weak)
   {
-    const bool is_directly_supported(!is_weak && steps <= 1);
-    const auto r(rank(c, i));
-
-    // In the endgame we score passed pawns higher if they are protected or if
-    // their advance is supported by friendly pawns.
-    if (is_directly_supported)
-      e.pawns_e[c] += db.pawn_protected_passed_e(r);
-    else
-      e.pawns_e[c] += db.pawn_passed_e(r);
-  }
+    const bool heavy(s.piece_count(!c, piece::rook)
+                     || s.piece_count(!c, piece::queen));
 
-  if (is_weak)
-  {
-    const auto f(file(i));
-    if (!is_opposed
-        && (s.piece_count(!c, piece::rook) || s.piece_count(!c, piece::queen)))
-      e.pawns_e[c] += db.pawn_weak_open_e(f);
-    else
-      e.pawns_e[c] += db.pawn_weak_e(f);
+    for (unsigned f(0); f < 8; ++f)
+    {
+      const int n(popcount(weak & file_bb(f)));
+      if (!n)
+        continue;
+
+      const int n_open(popcount(weak & ~opposed & file_bb(f)));
+      const int n_closed(n - n_open);
+
+      sink.pawn(c, WEAK_OPEN_M_FEATURE + f, n_open,
+                packed_score(p.pawn_weak_open_m(f), 0));
+      sink.pawn(c, WEAK_M_FEATURE + f, n_closed,
+                packed_score(p.pawn_weak_m(f), 0));
+
+      if (heavy)
+      {
+        sink.pawn(c, WEAK_OPEN_E_FEATURE + f, n_open,
+                  packed_score(0, p.pawn_weak_open_e(f)));
+        sink.pawn(c, WEAK_E_FEATURE + f, n_closed,
+                  packed_score(0, p.pawn_weak_e(f)));
+      }
+      else
+        sink.pawn(c, WEAK_E_FEATURE + f, n,
+                  packed_score(0, p.pawn_weak_e(f)));
+    }
   }
 }
 
-void eval_pawn_m(const state &s, square i, score_vector &e)
+// Pawn structure and king shelter of both sides.
+template<class P, class S>
+void eval_structure(const state &s, const attack_map &am, const P &src,
+                    S &sink)
 {
-  assert(s[i].type() == piece::pawn);
-  const color c(s[i].color());
-  const piece pawn(s[i]), xpawn(!c, piece::pawn);
+  const bitboard black(am.pieces[BLACK][piece::pawn]);
+  const bitboard white(am.pieces[WHITE][piece::pawn]);
 
-  e.pcsq_m[c] += db.pcsq_m(pawn, i);
+  eval_pawns(s, BLACK, black, white, src, sink);
+  eval_pawns(s, WHITE, white, black, src, sink);
 
-  bool is_passed(  true);  // we will be trying to disprove that
-  bool is_opposed(false);
+  eval_king_shield(s, src, sink);
+}
 
-  // The loop below detects doubled pawns, passed pawns and sets a flag on
-  // finding that our pawn is opposed by enemy pawn.
-  for (square sq(i + step_fwd(c)); rank(c, sq) < 7; sq += step_fwd(c))
+// Mobility and king attacks of both sides. Mobility only counts the squares
+// which aren't occupied by friendly pieces nor attacked by enemy pawns. The
+// king zone is made of the king square and of the adjacent squares.
+template<class P, class S>
+void eval_activity(const attack_map &am, const P &src, S &sink)
+{
+  const parameters &p(values(src));
+
+  for (unsigned c(0); c < 2; ++c)
   {
-    if (s[sq].type() == piece::pawn)
+    const bitboard area(~am.occupancy[c] & ~am.attacked_by[!c][piece::pawn]);
+
+    for (unsigned i(0); i < am.list_size[c]; ++i)
     {
-      is_passed = false;
+      const auto &pa(am.list[c][i]);
+      const unsigned n(popcount(pa.to & area));
 
-      if (s[sq] == pawn)
-        e.pawns_m[c] += db.pawn_doubled_m();
-      else
-      {
-        assert(s[sq] == xpawn);
-        is_opposed = true;
-        break;
-      }
+      sink.mobility(c, MOBILITY_FEATURE + 28 * (pa.type - piece::knight) + n,
+                    1, p.mobility(pa.type, n));
     }
 
-    if (file(sq) > FILE_A && s[sq - 1] == xpawn)
-      is_passed = false;
-    else if (file(sq) < FILE_H && s[sq + 1] == xpawn)
-      is_passed = false;
-  }
+    if (!am.pieces[!c][piece::king])
+      continue;
 
-  // Isolated and/or backward pawn.
-  bool is_weak(true);  // we will be trying to disprove that
+    const square k(lsb(am.pieces[!c][piece::king]));
+    const bitboard zone(bb(k) | king_attacks(k));
 
-  // Going backwards and checking whether pawn has support.
-  unsigned steps(0);
-  for (square sq(i); rank(c, sq); sq -= step_fwd(c), ++steps)
-  {
-    if (file(sq) > FILE_A && s[sq - 1] == pawn)
-    {
-      is_weak = false;
-      break;
-    }
-    if (file(sq) < FILE_H && s[sq + 1] == pawn)
-    {
-      is_weak = false;
-      break;
-    }
+    for (auto t : {piece::knight, piece::bishop, piece::rook, piece::queen})
+      if (const bitboard b = am.attacked_by[c][t] & zone)
+        sink.king_attack(c, KING_ATTACK_FEATURE + t - piece::knight,
+                         popcount(b), p.king_attack(t));
+
+    sink.king_attack(c, KING_ATTACK2_FEATURE,
+                     popcount(am.attacked2[c] & zone), p.king_attack2());
   }
+}
 
-  if (is_passed)
-    e.pawns_m[c] += db.pawn_passed_m(rank(c, i));
+// Positional terms (material terms come from the material entry and
+// piece/square values are already in `e`). Mid-game and end-game scores are
+// accumulated together (see `packed_score`).
+template<class P>
+void eval_pieces(const state &s, const P &src, score_vector &e)
+{
+  const attack_map am(s);
+
+  score_sink sink(e);
+  eval_structure(s, am, src, sink);
+  eval_activity(am, src, sink);
+
+  const packed_score total(
+    e.pcsq[s.side()] - e.pcsq[!s.side()]
+    + e.pawns[s.side()] - e.pawns[!s.side()]
+    + e.mobility[s.side()] - e.mobility[!s.side()]
+    + packed_score(e.king_shield[s.side()] - e.king_shield[!s.side()]
+                   + e.king_attack[s.side()] - e.king_attack[!s.side()],
+                   0));
+
+  e.mg = total.mg();
+  e.eg = total.eg();
+}
 
-  if (is_weak)
+// End-game scale factor of side `c`: the one of the specialised scaling
+// function, when available and applicable, or the one of the material
+// configuration.
+unsigned scale_factor(const state &s, const material_entry &me, color c)
+{
+  if (const auto f = me.endgame.scale[c])
   {
-    const auto f(file(i));
-    e.pawns_m[c] += is_opposed ? db.pawn_weak_m(f) : db.pawn_weak_open_m(f);
+    const unsigned sf(f(s, c));
+    if (sf != endgame::SCALE_NONE)
+      return sf;
   }
+
+  return me.scale[c];
 }
 
-void eval_e(const state &s, score_vector &e)
+// Scales the side to move relative score `v` according to the material
+// configuration (see `material_entry::scale`).
+score scale(const state &s, const material_entry &me, score v)
 {
-  for (square i(0); i < 64; ++i)
-    if (s[i] != EMPTY)
-      switch (s[i].id())
-      {
-      case BPAWN.id():
-      case WPAWN.id():
-        eval_pawn_e(s, i, e);
-        break;
+  const color strong(v > 0 ? s.side() : !s.side());
+  return v * int(scale_factor(s, me, strong))
+         / int(material_entry::SCALE_NORMAL);
+}
 
-      default:
-        e.pcsq_e[s[i].color()] += db.pcsq_e(s[i], i);
-      }
+score_vector::score_vector(const state &s)
+  : score_vector(s, material_db.probe(s))
+{
+}
 
-  e.eg = e.pcsq_e[s.side()] - e.pcsq_e[!s.side()]
-         + e.pawns_e[s.side()] - e.pawns_e[!s.side()];
+score_vector::score_vector(const state &s, const material_entry &me)
+  : score_vector(s, me, engine_parameters())
+{
 }
 
-void eval_m(const state &s, score_vector &e)
+// The piece/square values incrementally updated by the state refer to the
+// engine parameters: with other parameters they're computed scanning the
+// board.
+template<class P>
+score_vector::score_vector(const state &s, const material_entry &me,
+                           const P &src)
+  : phase(me.phase),
+    material{me.material[BLACK], me.material[WHITE]},
+    adjust_material{me.adjust_material[BLACK], me.adjust_material[WHITE]},
+    king_shield{0, 0}, king_attack{0, 0}, pawns(), mobility(),
+    pcsq{s.pcsq(BLACK), s.pcsq(WHITE)}, eg(), mg()
 {
-  for (square i(0); i < 64; ++i)
-    if (s[i] != EMPTY)
-      switch (s[i].id())
-      {
-      case BPAWN.id():
-      case WPAWN.id():
-        eval_pawn_m(s, i, e);
-        break;
+  const parameters &p(values(src));
 
-      default:
-        e.pcsq_m[s[i].color()] += db.pcsq_m(s[i], i);
-      }
+  if (&p != &values(engine_parameters()))
+  {
+    pcsq[BLACK] = pcsq[WHITE] = packed_score();
 
-  eval_king_shield(s, e);
+    for (square i(0); i < 64; ++i)
+      if (s[i] != EMPTY)
+        pcsq[s[i].color()] += p.pcsq(s[i], i);
+  }
 
-  e.mg = e.pcsq_m[s.side()] - e.pcsq_m[!s.side()]
-         + e.king_shield[s.side()] - e.king_shield[!s.side()]
-         + e.pawns_m[s.side()] - e.pawns_m[!s.side()];
+  eval_pieces(s, src, *this);
 }
 
-// Phase index: 0 is opening, 256 endgame.
-int phase256(const state &s)
+template score_vector::score_vector(const state &, const material_entry &,
+                                    const parameters &);
+template score_vector::score_vector(const state &, const material_entry &,
+                                    const baked_parameters &);
+
+template<class P>
+score eval(const state &s, const material_entry &me, const P &p)
 {
-  constexpr int knight_phase = 1;
-  constexpr int bishop_phase = 1;
-  constexpr int rook_phase   = 2;
-  constexpr int queen_phase  = 4;
+  if (me.draw)
+    return 0;
+  if (me.endgame.value)
+    return me.endgame.value(s, me.endgame.strong);
 
-  constexpr int total_phase =
-    knight_phase * 4 + bishop_phase * 4 + rook_phase * 4 + queen_phase * 2;
+  const score_vector e(s, me, p);
 
-  int p(total_phase);
+  return scale(s, me,
+               e.material[s.side()] - e.material[!s.side()]
+               + e.adjust_material[s.side()] - e.adjust_material[!s.side()]
+               + (e.mg * (256 - e.phase) + e.eg * e.phase) / 256);
+}
 
-  p -= s.piece_count(BLACK, piece::knight);
-  p -= s.piece_count(BLACK, piece::bishop);
-  p -= s.piece_count(BLACK,   piece::rook);
-  p -= s.piece_count(BLACK,  piece::queen);
+score eval(const state &s)
+{
+  const material_entry &me(material_db.probe(s));
 
-  p -= s.piece_count(WHITE, piece::knight);
-  p -= s.piece_count(WHITE, piece::bishop);
-  p -= s.piece_count(WHITE,   piece::rook);
-  p -= s.piece_count(WHITE,  piece::queen);
+  // Recognized endgames take precedence over the network too.
+  if (nnue::enabled() && !me.draw && !me.endgame.value)
+    return nnue::eval(s);
 
-  p = std::max(0, p);
+  return eval(s, me, engine_parameters());
+}
 
-  assert(0 <= p && p <= total_phase);
-  p = (p * 256 + total_phase / 2) / total_phase;
-  assert(0 <= p && p <= 256);
+// Classical evaluation of `s` with a specific set of parameters. It doesn't
+// use shared tables (so different threads can use different parameters at
+// the same time) and gives the same result of `eval` for the engine
+// parameters.
+score eval(const state &s, const parameters &p)
+{
+  return eval(s, make_material_entry(s, p), p);
+}
 
-  return p;
+score eval(const state &s, baked_parameters p)
+{
+  return eval(s, make_material_entry(s, p), p);
 }
 
-score_vector::score_vector(const state &s)
-  : phase(), material{0, 0}, adjust_material{0, 0}, king_shield{0, 0},
-    pawns_e{0, 0}, pawns_m{0, 0}, pcsq_e{0, 0}, pcsq_m{0, 0}, eg(), mg()
+// Fills `fv` with the features of `s` (see `feature_vector`). The pawn
+// structure, king shelter and piece activity features come from the same
+// code used by `eval`.
+void features(const state &s, feature_vector &fv)
 {
-  eval_e(s, *this);
-  eval_m(s, *this);
+  const material_entry &me(material_db.probe(s));
+  const color stm(s.side());
+
+  // Recognized endgames don't depend on the weights (see
+  // `feature_vector::recognized`).
+  fv.recognized = me.endgame.value && !me.draw;
+  if (fv.recognized)
+  {
+    fv.features.clear();
+    fv.phase = 0;
+    fv.scale_stm = fv.scale_xstm = 0;
+    fv.value = me.endgame.value(s, me.endgame.strong);
+    return;
+  }
+
+  int counts[FEATURES] = {};
+  feature_sink sink(stm, counts);
 
   for (square i(0); i < 64; ++i)
     if (s[i] != EMPTY)
-      material[s[i].color()] += s[i].value();
+    {
+      const piece pc(s[i]);
+      const color c(pc.color());
 
-  // Adjusting material value for the various combinations of pieces.
-  for (unsigned c(BLACK); c <= WHITE; ++c)
+      sink.add(c, PCSQ_FEATURE + 64 * pc.type() + (c == WHITE ? i : flip(i)),
+               1);
+      if (pc.type() != piece::king)
+        sink.add(c, MATERIAL_FEATURE + pc.type(), 1);
+    }
+
+  // Adjustments of the material value (see the material table).
+  for (color c : {BLACK, WHITE})
   {
-    const auto pawns(  s.piece_count(c,   piece::pawn));
+    const auto n_pawns(s.piece_count(c,   piece::pawn));
     const auto knights(s.piece_count(c, piece::knight));
     const auto rooks(  s.piece_count(c,   piece::rook));
 
     if (s.piece_count(c, piece::bishop) > 1)
-      adjust_material[c] += db.bishop_pair();
+      sink.add(c, BISHOP_PAIR_FEATURE, 1);
     if (knights > 1)
-      adjust_material[c] += db.knight_pair();
+      sink.add(c, KNIGHT_PAIR_FEATURE, 1);
     if (rooks > 1)
-      adjust_material[c] += db.rook_pair();
+      sink.add(c, ROOK_PAIR_FEATURE, 1);
 
-    adjust_material[c] += db.n_adj(pawns) * knights;
-    adjust_material[c] += db.r_adj(pawns) *   rooks;
+    sink.add(c, KNIGHT_ADJ_FEATURE + n_pawns, knights);
+    sink.add(c, ROOK_ADJ_FEATURE + n_pawns, rooks);
   }
 
-  // The, so called, tapered eval: a technique used in evaluation to make a
-  // smooth transition between the phases of the game using a fine grained
-  // numerical game phase value considering type of captured pieces so far.
-  // The technique aggregates two distinct scores for the position, with
-  // weights corresponding to the opening and endgame. The current game phase
-  // is then used to interpolate between these values. The idea is to remove
-  // evaluation discontinuity.
-  phase = phase256(s);
+  const attack_map am(s);
+  eval_structure(s, am, engine_parameters(), sink);
+  eval_activity(am, engine_parameters(), sink);
+
+  fv.features.clear();
+  for (unsigned id(0); id < FEATURES; ++id)
+    if (counts[id])
+      fv.features.push_back({static_cast<std::uint16_t>(id),
+                             static_cast<std::int8_t>(counts[id]),
+                             phase_of(id)});
+
+  fv.phase = me.phase;
+  fv.scale_stm = me.draw ? 0 : scale_factor(s, me, stm);
+  fv.scale_xstm = me.draw ? 0 : scale_factor(s, me, !stm);
+  fv.value = 0;
 }
 
-score eval(const state &s)
+feature_vector features(const state &s)
 {
-  score_vector e(s);
+  feature_vector fv;
+  features(s, fv);
+  return fv;
+}
+
+// A cheap estimate of `eval` made only of the material and piece/square terms
+// (both available without scanning the board). The full evaluation usually
+// differs from the estimate by less than `LAZY_EVAL_MARGIN` (a heuristic
+// margin, not a bound).
+score lazy_eval(const state &s)
+{
+  const material_entry &me(material_db.probe(s));
+  if (me.draw)
+    return 0;
+  if (me.endgame.value)
+    return me.endgame.value(s, me.endgame.strong);
+
+  return scale(s, me,
+               me.material[s.side()] - me.material[!s.side()]
+               + me.adjust_material[s.side()] - me.adjust_material[!s.side()]
+               + (s.pcsq(s.side()) - s.pcsq(!s.side())).taper(me.phase));
+}
+
+// Evaluates many positions at once: `scores[i]` is set to `eval(positions[i])`.
+// Positions are split among `threads` threads (`0` means one thread for each
+// core). Small batches use fewer threads.
+void eval_batch(span<const state> positions, span<score> scores,
+                unsigned threads)
+{
+  assert(positions.size() == scores.size());
+
+  constexpr std::size_t MIN_PER_THREAD = 4096;
 
-  return
-    e.material[s.side()] - e.material[!s.side()]
-    + e.adjust_material[s.side()] - e.adjust_material[!s.side()]
-    + (e.mg * (256 - e.phase) + e.eg * e.phase) / 256;
+  parallel_for(positions.size(), threads, MIN_PER_THREAD,
+               [&](unsigned, std::size_t from, std::size_t to)
+               {
+                 for (std::size_t i(from); i < to; ++i)
+                   scores[i] = eval(positions[i]);
+               });
 }
 
 }  // namespace testudo
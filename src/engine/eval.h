@@ -11,33 +11,55 @@
 #if !defined(TESTUDO_EVAL_H)
 #define      TESTUDO_EVAL_H
 
-#include "state.h"
+#include "material.h"
+#include "nonstd.h"
 
 namespace testudo
 {
 
+class baked_parameters;
+class parameters;
+
 struct score_vector
 {
   explicit score_vector(const state &);
+  score_vector(const state &, const material_entry &);
+  template<class P>
+  score_vector(const state &, const material_entry &, const P &);
 
   int phase;
 
   score material[2];
   score adjust_material[2];
 
-  score king_shield[2];
-
-  score pawns_e[2];
-  score pawns_m[2];
+  score king_shield[2];  // mid-game only
+  score king_attack[2];  // mid-game only
 
-  score pcsq_e[2];
-  score pcsq_m[2];
+  packed_score    pawns[2];
+  packed_score mobility[2];
+  packed_score     pcsq[2];
 
   score eg;
   score mg;
 };
 
+// Static evaluation of a position (classical or neural network based, see
+// `nnue::enable`).
 extern score eval(const state &);
+extern score eval(const state &, const parameters &);
+extern score eval(const state &, baked_parameters);
+
+// Typical maximum of the terms ignored by `lazy_eval` (pawn structure, king
+// shield, piece activity, mobility and king attack), i.e. of the difference
+// between `eval` and `lazy_eval`. It's a heuristic margin, not a bound:
+// measured on positions of random games, the difference exceeds it in about
+// 0.06% of the cases (99.9th percentile 378, maximum 560). Meaningful only
+// for the classical evaluation.
+constexpr score LAZY_EVAL_MARGIN = 400;
+
+extern score lazy_eval(const state &);
+
+extern void eval_batch(span<const state>, span<score>, unsigned = 0);
 
 }  // namespace testudo
 
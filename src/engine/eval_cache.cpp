@@ -0,0 +1,65 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "eval_cache.h"
+#include "eval.h"
+
+namespace testudo
+{
+
+eval_cache::eval_cache(std::uint8_t bits) : stats(), table_()
+{
+  resize(bits);
+}
+
+// Changes the size of the table to `2^bits` slots (the content is lost).
+void eval_cache::resize(std::uint8_t bits)
+{
+  assert(0 < bits && bits <= 32);
+
+  table_.resize(std::size_t(1) << bits);
+  clear();
+}
+
+void eval_cache::clear()
+{
+  // An empty slot behaves like a false match: the (very unlikely) key with
+  // zero upper bits gets a draw score.
+  std::fill(table_.begin(), table_.end(), slot{0, 0});
+}
+
+// Returns the static evaluation of `s` (see `testudo::eval`), computing it
+// only if it isn't already in the table.
+score eval_cache::eval(const state &s)
+{
+  const hash_t h(s.hash());
+  auto &e(table_[h & (table_.size() - 1)]);
+  const auto check(static_cast<std::uint32_t>(h >> 32));
+
+  if (stats_enabled)
+    ++stats.probes;
+
+  if (e.check == check)
+  {
+    if (stats_enabled)
+      ++stats.hits;
+    return e.value;
+  }
+
+  e.check = check;
+  e.value = testudo::eval(s);
+
+  return e.value;
+}
+
+}  // namespace testudo
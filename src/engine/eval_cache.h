@@ -0,0 +1,73 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_EVAL_CACHE_H)
+#define      TESTUDO_EVAL_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "state.h"
+
+namespace testudo
+{
+
+// A direct-mapped table of static evaluations (aka eval hash).
+// The same positions are evaluated many times (e.g. the stand-pat score in
+// the quiescence search after a transposition, MCTS leaves): the table stores
+// the final `eval()` value and returns it without recomputing.
+// Every slot is tagged with the upper 32 bits of the hash key (the lower bits
+// are used for indexing). Since the table is just a cache, a rare false match
+// only produces a slightly wrong static evaluation.
+class eval_cache
+{
+public:
+  // Counters describing the use of the table. They're updated only if the
+  // `TESTUDO_TT_STATS` macro is defined.
+  struct statistics
+  {
+    statistics() : probes(0), hits(0) {}
+    void reset() { *this = statistics(); }
+
+    std::uintmax_t probes;  // calls to `eval`
+    std::uintmax_t   hits;  // probes finding the position
+  };
+
+#if defined(TESTUDO_TT_STATS)
+  static constexpr bool stats_enabled = true;
+#else
+  static constexpr bool stats_enabled = false;
+#endif
+
+  explicit eval_cache(std::uint8_t bits = 16);
+
+  // Size of the table in number of slots (`2^bits`).
+  std::size_t size() const noexcept { return table_.size(); }
+  void resize(std::uint8_t);
+
+  void clear();
+
+  score eval(const state &);
+
+  statistics stats;
+
+private:
+  struct slot
+  {
+    std::uint32_t check;  // upper 32 bits of the hash key
+    score value;
+  };
+
+  std::vector<slot> table_;
+};
+
+}  // namespace testudo
+
+#endif  // include guard
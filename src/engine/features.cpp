@@ -0,0 +1,239 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <cassert>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#include "features.h"
+#include "material.h"
+#include "parameters.h"
+
+namespace testudo
+{
+
+namespace
+{
+
+// Marks a recognized position in the binary format (real phases are in the
+// [0, 256] range).
+const std::uint16_t RECOGNIZED_PHASE = 0xFFFF;
+
+bool shield_feature(unsigned id)
+{
+  return SHIELD1_US_FEATURE <= id && id <= SHIELD2_THEM_FEATURE;
+}
+
+}  // unnamed namespace
+
+feature_phase phase_of(unsigned id)
+{
+  assert(id < FEATURES);
+
+  if (id < MATERIAL_FEATURE)
+    return feature_phase::both;
+  if (id < DOUBLED_FEATURE)
+    return feature_phase::none;
+  if (id < WEAK_M_FEATURE)
+    return feature_phase::both;
+  if (id < WEAK_E_FEATURE)
+    return feature_phase::mg;
+  if (id < WEAK_OPEN_M_FEATURE)
+    return feature_phase::eg;
+  if (id < WEAK_OPEN_E_FEATURE)
+    return feature_phase::mg;
+  if (id < SHIELD1_US_FEATURE)
+    return feature_phase::eg;
+  if (id < MOBILITY_FEATURE)
+    return feature_phase::mg;
+  if (id < KING_ATTACK_FEATURE)
+    return feature_phase::both;
+
+  return feature_phase::mg;
+}
+
+// Weights of the features (indexed by `feature_id`) for parameters `p`. Terms
+// outside the tapered evaluation use only the mid-game half.
+std::vector<packed_score> feature_weights(const parameters &p)
+{
+  std::vector<packed_score> w(FEATURES);
+
+  for (unsigned t(piece::pawn); t <= piece::queen; ++t)
+  {
+    for (square i(0); i < 64; ++i)
+      w[PCSQ_FEATURE + 64 * t + i] = p.pcsq(piece(WHITE, t), i);
+
+    w[MATERIAL_FEATURE + t] = packed_score(piece(WHITE, t).value(), 0);
+  }
+
+  w[BISHOP_PAIR_FEATURE] = packed_score(p.bishop_pair(), 0);
+  w[KNIGHT_PAIR_FEATURE] = packed_score(p.knight_pair(), 0);
+  w[  ROOK_PAIR_FEATURE] = packed_score(  p.rook_pair(), 0);
+
+  for (unsigned n(0); n < 9; ++n)
+  {
+    w[KNIGHT_ADJ_FEATURE + n] = packed_score(p.n_adj(n), 0);
+    w[  ROOK_ADJ_FEATURE + n] = packed_score(p.r_adj(n), 0);
+  }
+
+  w[DOUBLED_FEATURE] = p.pawn_doubled();
+
+  for (unsigned r(1); r < 7; ++r)
+  {
+    w[PASSED_FEATURE + r] = p.pawn_passed(r);
+    w[PROTECTED_PASSED_FEATURE + r] = p.pawn_protected_passed(r);
+  }
+
+  for (unsigned f(0); f < 8; ++f)
+  {
+    w[     WEAK_M_FEATURE + f] = packed_score(     p.pawn_weak_m(f), 0);
+    w[     WEAK_E_FEATURE + f] = packed_score(0,      p.pawn_weak_e(f));
+    w[WEAK_OPEN_M_FEATURE + f] = packed_score(p.pawn_weak_open_m(f), 0);
+    w[WEAK_OPEN_E_FEATURE + f] = packed_score(0, p.pawn_weak_open_e(f));
+  }
+
+  w[SHIELD1_US_FEATURE] = w[SHIELD1_THEM_FEATURE] =
+    packed_score(p.pawn_shield1(), 0);
+  w[SHIELD2_US_FEATURE] = w[SHIELD2_THEM_FEATURE] =
+    packed_score(p.pawn_shield2(), 0);
+
+  for (auto t : {piece::knight, piece::bishop, piece::rook, piece::queen})
+  {
+    for (unsigned n(0); n < 28; ++n)
+      w[MOBILITY_FEATURE + 28 * (t - piece::knight) + n] = p.mobility(t, n);
+
+    w[KING_ATTACK_FEATURE + t - piece::knight] =
+      packed_score(p.king_attack(t), 0);
+  }
+
+  w[KING_ATTACK2_FEATURE] = packed_score(p.king_attack2(), 0);
+
+  return w;
+}
+
+// Evaluation of the position described by the features (`w` are the weights
+// of the features, see `feature_weights`). With the weights of the engine
+// parameters it's equal to the classical `eval`.
+score feature_vector::eval(const std::vector<packed_score> &w) const
+{
+  assert(w.size() == FEATURES);
+
+  if (recognized)
+    return value;
+
+  score base(0);
+  packed_score total;
+  score shield[2] = {0, 0};  // side to move / opponent
+
+  for (const auto &f : features)
+    if (f.phase == feature_phase::none)
+      base += w[f.index].mg() * f.count;
+    else if (shield_feature(f.index))
+      shield[f.index >= SHIELD1_THEM_FEATURE] += w[f.index].mg() * f.count;
+    else
+      total += w[f.index] * f.count;
+
+  total += packed_score(shield[0] / 2 - shield[1] / 2, 0);
+
+  const score v(base
+                + (total.mg() * (256 - phase) + total.eg() * phase) / 256);
+
+  return v * (v > 0 ? scale_stm : scale_xstm)
+         / int(material_entry::SCALE_NORMAL);
+}
+
+// Compact binary format (native byte order): phase (16 bits), the two scale
+// factors, the number of features (8 bits) and then index (16 bits) / count
+// (8 bits) of every feature.
+// Recognized positions are stored as `RECOGNIZED_PHASE`, the value (16 bits)
+// in place of the scale factors and no feature.
+bool feature_vector::save(std::ostream &out) const
+{
+  assert(features.size() < 256);
+
+  // The record is assembled in a buffer and written at once (much faster
+  // than many small writes).
+  char buf[5 + 255 * 3];
+  char *b(buf);
+
+  if (recognized)
+  {
+    const auto v(static_cast<std::int16_t>(value));
+    std::memcpy(b, &RECOGNIZED_PHASE, sizeof(RECOGNIZED_PHASE));
+    b += sizeof(RECOGNIZED_PHASE);
+    std::memcpy(b, &v, sizeof(v));
+    b += sizeof(v);
+    *b++ = 0;
+
+    return !!out.write(buf, b - buf);
+  }
+
+  const auto p(static_cast<std::uint16_t>(phase));
+  std::memcpy(b, &p, sizeof(p));
+  b += sizeof(p);
+  *b++ = static_cast<char>(scale_stm);
+  *b++ = static_cast<char>(scale_xstm);
+  *b++ = static_cast<char>(features.size());
+
+  for (const auto &f : features)
+  {
+    std::memcpy(b, &f.index, sizeof(f.index));
+    b += sizeof(f.index);
+    *b++ = static_cast<char>(f.count);
+  }
+
+  return !!out.write(buf, b - buf);
+}
+
+bool feature_vector::load(std::istream &in)
+{
+  std::uint16_t p;
+  char scales[2];
+  std::uint8_t n;
+
+  if (!in.read(reinterpret_cast<char *>(&p), sizeof(p))
+      || !in.read(scales, sizeof(scales))
+      || !in.read(reinterpret_cast<char *>(&n), 1))
+    return false;
+
+  recognized = p == RECOGNIZED_PHASE;
+  if (recognized)
+  {
+    std::int16_t v;
+    std::memcpy(&v, scales, sizeof(v));
+
+    value = v;
+    phase = 0;
+    scale_stm = scale_xstm = 0;
+    features.clear();
+    return n == 0;
+  }
+
+  value = 0;
+  phase = p;
+  scale_stm = static_cast<std::uint8_t>(scales[0]);
+  scale_xstm = static_cast<std::uint8_t>(scales[1]);
+
+  features.resize(n);
+  for (auto &f : features)
+  {
+    if (!in.read(reinterpret_cast<char *>(&f.index), sizeof(f.index))
+        || !in.read(reinterpret_cast<char *>(&f.count), 1)
+        || f.index >= FEATURES)
+      return false;
+
+    f.phase = phase_of(f.index);
+  }
+
+  return true;
+}
+
+}  // namespace testudo
@@ -0,0 +1,112 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_FEATURES_H)
+#define      TESTUDO_FEATURES_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "state.h"
+
+namespace testudo
+{
+
+class parameters;
+
+// Identifiers of the terms of the classical evaluation. Every feature is a
+// value of the `parameters` tables (or a piece value) and the evaluation is
+// the sum of the features, weighted by their count, followed by the
+// tapering and scaling steps (see `feature_vector::eval`).
+enum feature_id : unsigned
+{
+  PCSQ_FEATURE = 0,                              // type x square (WHITE view)
+  MATERIAL_FEATURE = PCSQ_FEATURE + 6 * 64,      // piece type
+  BISHOP_PAIR_FEATURE = MATERIAL_FEATURE + 6,
+  KNIGHT_PAIR_FEATURE,
+  ROOK_PAIR_FEATURE,
+  KNIGHT_ADJ_FEATURE,                            // number of own pawns
+  ROOK_ADJ_FEATURE = KNIGHT_ADJ_FEATURE + 9,     // number of own pawns
+  DOUBLED_FEATURE = ROOK_ADJ_FEATURE + 9,
+  PASSED_FEATURE,                                // relative rank
+  PROTECTED_PASSED_FEATURE = PASSED_FEATURE + 7,  // relative rank
+  WEAK_M_FEATURE = PROTECTED_PASSED_FEATURE + 7,  // file
+  WEAK_E_FEATURE = WEAK_M_FEATURE + 8,            // file
+  WEAK_OPEN_M_FEATURE = WEAK_E_FEATURE + 8,       // file
+  WEAK_OPEN_E_FEATURE = WEAK_OPEN_M_FEATURE + 8,  // file
+
+  // King shelter of the side to move / of the opponent. Counts are the sum
+  // over two shelters (current and after castling) whose average is used:
+  // they're kept apart since the average is truncated independently for
+  // every side.
+  SHIELD1_US_FEATURE = WEAK_OPEN_E_FEATURE + 8,
+  SHIELD2_US_FEATURE,
+  SHIELD1_THEM_FEATURE,
+  SHIELD2_THEM_FEATURE,
+
+  // Number of knights / bishops / rooks / queens attacking a given number of
+  // squares (index `28 * (type - knight) + squares`, see
+  // `parameters::mobility`).
+  MOBILITY_FEATURE,
+  // Squares of the enemy king zone attacked by a piece type (`type -
+  // knight`) / attacked at least twice.
+  KING_ATTACK_FEATURE = MOBILITY_FEATURE + 4 * 28,
+  KING_ATTACK2_FEATURE = KING_ATTACK_FEATURE + 4,
+
+  FEATURES
+};
+
+// Game phases a feature contributes to (`none` marks terms outside the
+// tapered evaluation, e.g. material).
+enum class feature_phase : std::uint8_t {both, mg, eg, none};
+
+feature_phase phase_of(unsigned);
+
+struct feature
+{
+  std::uint16_t index;  // see `feature_id`
+  std::int8_t count;    // side to move minus opponent
+  feature_phase phase;
+};
+
+// Sparse description of a position as seen by the classical evaluation.
+// Features are sorted by index and have non-zero counts.
+struct feature_vector
+{
+  score eval(const std::vector<packed_score> &) const;
+
+  bool load(std::istream &);
+  bool save(std::ostream &) const;
+
+  std::vector<feature> features;
+
+  int phase;  // 0 is opening, 256 endgame (see `phase256`)
+
+  // End-game scale factors for the side to move and the opponent (see
+  // `material_entry::scale`). Both are zero for drawn material.
+  std::uint8_t scale_stm;
+  std::uint8_t scale_xstm;
+
+  // Positions evaluated by a specialised endgame function (see
+  // `endgame::value_fn`) don't depend on the weights: `eval` returns
+  // `value`.
+  bool recognized = false;
+  score value = 0;
+};
+
+extern feature_vector features(const state &);
+extern void features(const state &, feature_vector &);
+
+extern std::vector<packed_score> feature_weights(const parameters &);
+
+}  // namespace testudo
+
+#endif  // include guard
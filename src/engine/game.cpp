@@ -16,6 +16,21 @@
 namespace testudo
 {
 
+// Sets up a new game (keeping the current hash table size and interface
+// settings).
+// The hash table isn't cleared (it could contain the work of a previous
+// session loaded from file): entries of the past games are aged and so
+// replaced first.
+void game::new_game()
+{
+  tt_.inc_age();
+
+  states_ = {state(state::setup::start)};
+  computer_side_ = -1;
+  max_depth_ = 0;
+  time_info_ = time_info();
+}
+
 bool game::make_move(const move &m)
 {
   auto current(current_state());
@@ -53,8 +68,13 @@ void game::max_time(std::chrono::milliseconds t)
 // Returns the best move found (if available).
 move game::think(bool verbose, bool analyze_mode)
 {
-  ab_search s(states_, &tt_);
-  //mcts_search s(states_);
+  ab_search s(states_, &tt_, &ec_);
+  //mcts_search s(states_, &ec_);
+
+  // Only the first search after loading a hash file resumes from the stored
+  // depth (see `ab_search::run`).
+  s.resume = resume_;
+  resume_ = false;
 
   if (analyze_mode)
   {
@@ -16,6 +16,7 @@
 
 #include "state.h"
 #include "cache.h"
+#include "eval_cache.h"
 
 namespace testudo
 {
@@ -24,15 +25,28 @@ class game
 {
 public:
   game() : show_search_info(true), ics(false),
-           tt_(), states_({state(state::setup::start)}), computer_side_(-1),
-           max_depth_(0), time_info_()
+           tt_(), ec_(), states_({state(state::setup::start)}),
+           computer_side_(-1), max_depth_(0), resume_(false), time_info_()
   {}
 
+  void new_game();
+
   bool make_move(const move &);
   bool take_back(unsigned = 1);
 
   void max_depth(unsigned d) { max_depth_ = d; }
 
+  // Size of the transposition table (megabytes).
+  void hash_size(std::size_t mb) { tt_.size_mb(mb); }
+
+  // Snapshots of the transposition table (see `cache::save`/`cache::load`).
+  bool save_hash(const std::string &f) const { return tt_.save(f); }
+  bool load_hash(const std::string &f) { return resume_ = tt_.load(f); }
+
+  // Shares the transposition table with other processes (see
+  // `cache::share`).
+  bool share_hash(const std::string &n) { return tt_.share(n); }
+
   void max_time(std::chrono::milliseconds);
 
   void level(unsigned m, std::chrono::milliseconds t)
@@ -56,11 +70,13 @@ public:
 
 private:
   cache tt_;
+  eval_cache ec_;
 
   std::vector<state> states_;
 
   int computer_side_;                   // -1, BLACK, WHITE
   unsigned max_depth_;                  // Maximum search depth
+  bool resume_;                         // Next search resumes a snapshot
 
   struct time_info
   {
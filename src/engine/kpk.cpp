@@ -0,0 +1,193 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <vector>
+
+#include "kpk.h"
+#include "attacks.h"
+#include "util.h"
+
+namespace testudo
+{
+
+namespace kpk
+{
+
+namespace
+{
+
+// Results are bit flags so that the results of the successors of a position
+// can be merged with a single `|`.
+enum result : std::uint8_t {INVALID = 0, UNKNOWN = 1, DRAW = 2, WIN = 4};
+
+constexpr unsigned SIZE = 2 * 24 * 64 * 64;
+
+// Pawn on files A-D and ranks 2-7.
+unsigned index(color stm, square bk, square wk, square wp)
+{
+  assert(file(wp) <= FILE_D);
+  assert(1 <= rank(wp) && rank(wp) <= 6);
+
+  return unsigned(wk) | unsigned(bk) << 6 | unsigned(stm) << 12
+         | (file(wp) + 4 * (rank(wp) - 1)) << 13;
+}
+
+struct position
+{
+  explicit position(unsigned idx)
+    : wk(idx & 63), bk((idx >> 6) & 63), wp(to_square((idx >> 13) & 3,
+                                                      (idx >> 15) + 1)),
+      stm((idx >> 12) & 1)
+  {
+  }
+
+  square wk, bk, wp;
+  color stm;
+};
+
+// Classification not depending on the other positions: illegal positions,
+// immediate promotions, stalemates and captures of the pawn.
+result initial(const position &p)
+{
+  const square promotion(to_square(file(p.wp), 7));
+
+  if (distance(p.wk, p.bk) <= 1 || p.wk == p.wp || p.bk == p.wp
+      || (p.stm == WHITE && (pawn_attacks(WHITE, bb(p.wp)) & bb(p.bk))))
+    return INVALID;
+
+  if (p.stm == WHITE && rank(p.wp) == 6
+      && p.wk != promotion && p.bk != promotion
+      && (distance(p.bk, promotion) > 1 || distance(p.wk, promotion) == 1))
+    return WIN;
+
+  if (p.stm == BLACK)
+  {
+    const bitboard moves(king_attacks(p.bk) & ~king_attacks(p.wk));
+
+    if (!(moves & ~pawn_attacks(WHITE, bb(p.wp))) || (moves & bb(p.wp)))
+      return DRAW;
+  }
+
+  return UNKNOWN;
+}
+
+using database = std::unique_ptr<std::atomic<std::uint8_t>[]>;
+
+unsigned get(const database &db, unsigned idx)
+{
+  return db[idx].load(std::memory_order_relaxed);
+}
+
+// Classification based on the successors: White wins if a move leads to a
+// win, Black draws if a move leads to a draw. Moves to illegal positions
+// are merged as `INVALID` (no bit set).
+result classify(const database &db, const position &p)
+{
+  unsigned r(INVALID);
+
+  if (p.stm == WHITE)
+  {
+    for (bitboard b(king_attacks(p.wk)); b; b &= b - 1)
+      r |= get(db, index(BLACK, p.bk, lsb(b), p.wp));
+
+    // Pushes to the last rank are already classified by `initial`.
+    if (rank(p.wp) < 6)
+    {
+      const square push(to_square(file(p.wp), rank(p.wp) + 1));
+      r |= get(db, index(BLACK, p.bk, p.wk, push));
+
+      if (rank(p.wp) == 1 && push != p.wk && push != p.bk)
+        r |= get(db, index(BLACK, p.bk, p.wk, to_square(file(p.wp), 3)));
+    }
+
+    return r & WIN ? WIN : r & UNKNOWN ? UNKNOWN : DRAW;
+  }
+
+  for (bitboard b(king_attacks(p.bk)); b; b &= b - 1)
+    r |= get(db, index(WHITE, lsb(b), p.wk, p.wp));
+
+  return r & DRAW ? DRAW : r & UNKNOWN ? UNKNOWN : WIN;
+}
+
+// Retrograde analysis: the unknown positions are classified again and again
+// until nothing changes.
+// Every pass is split among threads. Results only change from `UNKNOWN` to
+// a final value, so a thread reading a result just stored by another one
+// converges faster and is never wrong.
+std::bitset<SIZE> build()
+{
+  database db(new std::atomic<std::uint8_t>[SIZE]);
+  for (unsigned i(0); i < SIZE; ++i)
+    db[i].store(initial(position(i)), std::memory_order_relaxed);
+
+  std::atomic<bool> changed;
+
+  const auto work(
+    [&](unsigned, std::size_t first, std::size_t last)
+    {
+      bool found(false);
+
+      for (auto i(static_cast<unsigned>(first)); i < last; ++i)
+        if (get(db, i) == UNKNOWN)
+        {
+          const result r(classify(db, position(i)));
+
+          if (r != UNKNOWN)
+          {
+            db[i].store(r, std::memory_order_relaxed);
+            found = true;
+          }
+        }
+
+      if (found)
+        changed = true;
+    });
+
+  do
+  {
+    changed = false;
+    parallel_for(SIZE, 0, 0, work);
+  } while (changed);
+
+  std::bitset<SIZE> ret;
+  for (unsigned i(0); i < SIZE; ++i)
+    if (get(db, i) == WIN)
+      ret.set(i);
+
+  return ret;
+}
+
+}  // unnamed namespace
+
+bool probe(square wk, square wp, square bk, color stm)
+{
+  // Built on first use (thread safe initialization).
+  static const std::bitset<SIZE> bitbase(build());
+
+  assert(1 <= rank(wp) && rank(wp) <= 6);
+
+  // Horizontal mirroring.
+  if (file(wp) > FILE_D)
+  {
+    wk ^= 7;
+    wp ^= 7;
+    bk ^= 7;
+  }
+
+  return bitbase[index(stm, bk, wk, wp)];
+}
+
+}  // namespace kpk
+
+}  // namespace testudo
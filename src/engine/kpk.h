@@ -0,0 +1,36 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_KPK_H)
+#define      TESTUDO_KPK_H
+
+#include "square.h"
+
+namespace testudo
+{
+
+// King and pawn against king bitbase: one bit (win / draw) for every
+// position with White having the pawn on files A-D (the other ones are
+// mirrored), i.e. 2 sides x 24 pawn squares x 64 x 64 king squares = 24KB.
+//
+// The bitbase is built by retrograde analysis the first time it's probed
+// (a few milliseconds).
+namespace kpk
+{
+
+// `true` if White wins with White king on `wk`, White pawn on `wp`, Black
+// king on `bk` and `stm` to move. The position must be legal.
+extern bool probe(square wk, square wp, square bk, color stm);
+
+}  // namespace kpk
+
+}  // namespace testudo
+
+#endif  // include guard
@@ -0,0 +1,180 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <cassert>
+
+#include "material.h"
+#include "parameters.h"
+
+namespace testudo
+{
+
+namespace
+{
+
+score non_pawn_material(const state &s, color c)
+{
+  return s.piece_count(c, piece::knight) * piece(c, piece::knight).value()
+         + s.piece_count(c, piece::bishop) * piece(c, piece::bishop).value()
+         + s.piece_count(c, piece::rook) * piece(c, piece::rook).value()
+         + s.piece_count(c, piece::queen) * piece(c, piece::queen).value();
+}
+
+template<class P>
+void fill_entry(const state &s, const P &src, material_entry &e)
+{
+  const parameters &p(values(src));
+
+  e.key = s.material_key();
+
+  score npm[2];
+
+  for (color c : {BLACK, WHITE})
+  {
+    const auto n_pawns(s.piece_count(c,   piece::pawn));
+    const auto knights(s.piece_count(c, piece::knight));
+    const auto rooks(  s.piece_count(c,   piece::rook));
+
+    npm[c] = non_pawn_material(s, c);
+    e.material[c] = npm[c] + n_pawns * piece(c, piece::pawn).value()
+                    + piece(c, piece::king).value();
+
+    // Adjusting material value for the various combinations of pieces.
+    e.adjust_material[c] = 0;
+    if (s.piece_count(c, piece::bishop) > 1)
+      e.adjust_material[c] += p.bishop_pair();
+    if (knights > 1)
+      e.adjust_material[c] += p.knight_pair();
+    if (rooks > 1)
+      e.adjust_material[c] += p.rook_pair();
+
+    e.adjust_material[c] += p.n_adj(n_pawns) * knights;
+    e.adjust_material[c] += p.r_adj(n_pawns) *   rooks;
+  }
+
+  const score rook_value(piece(WHITE, piece::rook).value());
+  const score bishop_value(piece(WHITE, piece::bishop).value());
+
+  for (color c : {BLACK, WHITE})
+  {
+    e.scale[c] = material_entry::SCALE_NORMAL;
+
+    if (s.piece_count(c, piece::pawn))
+      continue;
+
+    // Without pawns a minor piece isn't enough to win and an advantage
+    // smaller than a rook is usually enough only for a draw (e.g. KRvKB,
+    // KRvKN).
+    if (npm[c] - npm[!c] <= bishop_value)
+      e.scale[c] = npm[c] < rook_value ? 0 : material_entry::SCALE_NORMAL / 4;
+
+    // Two knights cannot force mate against a bare king.
+    else if (s.piece_count(c, piece::knight) == 2
+             && npm[c] == 2 * piece(c, piece::knight).value()
+             && !npm[!c] && !s.piece_count(!c, piece::pawn))
+      e.scale[c] = 0;
+  }
+
+  e.draw = !s.piece_count(BLACK, piece::pawn)
+           && !s.piece_count(WHITE, piece::pawn)
+           && npm[BLACK] < rook_value && npm[WHITE] < rook_value;
+
+  // The, so called, tapered eval: a technique used in evaluation to make a
+  // smooth transition between the phases of the game using a fine grained
+  // numerical game phase value considering type of captured pieces so far.
+  // The technique aggregates two distinct scores for the position, with
+  // weights corresponding to the opening and endgame. The current game phase
+  // is then used to interpolate between these values. The idea is to remove
+  // evaluation discontinuity.
+  e.phase = phase256(s);
+
+  e.endgame = endgame::lookup(s);
+}
+
+}  // unnamed namespace
+
+thread_local material_table material_db;
+
+// Computes the material entry of `s` from scratch using the `p` parameters
+// (without touching the material table).
+template<class P>
+material_entry make_material_entry(const state &s, const P &p)
+{
+  material_entry e;
+  fill_entry(s, p, e);
+  return e;
+}
+
+template material_entry make_material_entry(const state &,
+                                            const parameters &);
+template material_entry make_material_entry(const state &,
+                                            const baked_parameters &);
+
+// Phase index: 0 is opening, 256 endgame.
+int phase256(const state &s)
+{
+  constexpr int knight_phase = 1;
+  constexpr int bishop_phase = 1;
+  constexpr int rook_phase   = 2;
+  constexpr int queen_phase  = 4;
+
+  constexpr int total_phase =
+    knight_phase * 4 + bishop_phase * 4 + rook_phase * 4 + queen_phase * 2;
+
+  int p(total_phase);
+
+  p -= s.piece_count(BLACK, piece::knight);
+  p -= s.piece_count(BLACK, piece::bishop);
+  p -= s.piece_count(BLACK,   piece::rook);
+  p -= s.piece_count(BLACK,  piece::queen);
+
+  p -= s.piece_count(WHITE, piece::knight);
+  p -= s.piece_count(WHITE, piece::bishop);
+  p -= s.piece_count(WHITE,   piece::rook);
+  p -= s.piece_count(WHITE,  piece::queen);
+
+  p = std::max(0, p);
+
+  assert(0 <= p && p <= total_phase);
+  p = (p * 256 + total_phase / 2) / total_phase;
+  assert(0 <= p && p <= 256);
+
+  return p;
+}
+
+// Table size must be a power of two.
+material_table::material_table(unsigned n) : table_(n)
+{
+  assert(n > 1 && (n & (n - 1)) == 0);
+  clear();
+}
+
+// Invalidates every entry (e.g. after a change of the evaluation parameters).
+void material_table::clear()
+{
+  // The key of the `i`-th slot is set to a value that cannot be stored in it
+  // (a zero key, i.e. the KvK ending, would otherwise match an empty slot).
+  for (std::size_t i(0); i < table_.size(); ++i)
+    table_[i].key = i + 1;
+}
+
+const material_entry &material_table::probe(const state &s)
+{
+  const hash_t key(s.material_key());
+  auto &e(table_[key & (table_.size() - 1)]);
+
+  if (e.key != key)
+    fill_entry(s, engine_parameters(), e);
+
+  return e;
+}
+
+}  // namespace testudo
@@ -0,0 +1,81 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_MATERIAL_H)
+#define      TESTUDO_MATERIAL_H
+
+#include <vector>
+
+#include "endgame.h"
+#include "state.h"
+
+namespace testudo
+{
+
+class baked_parameters;
+class parameters;
+
+// Evaluation terms depending only on the material on the board (i.e. on the
+// number of pieces of each type and color).
+struct material_entry
+{
+  static constexpr unsigned SCALE_NORMAL = 64;
+
+  hash_t key;
+
+  score material[2];         // sum of the piece values
+  score adjust_material[2];  // pairs, knights / rooks vs number of pawns
+
+  int phase;  // 0 is opening, 256 endgame (see `phase256`)
+
+  // End-game scale factor (`SCALE_NORMAL` means no scaling) applied when the
+  // corresponding side has the advantage. Small values mark material
+  // configurations that are hard / impossible to win.
+  std::uint8_t scale[2];
+
+  // Neither side has enough material to mate.
+  bool draw;
+
+  // Specialised evaluation / scaling functions for the material
+  // configuration (if any).
+  endgame::functions endgame;
+};
+
+// A small hash table lazily filled with material entries. The number of
+// distinct material configurations reached during a search is tiny, so
+// almost every probe is a hit and the eval gets all the material related
+// terms with a single lookup.
+// Entries are computed with the engine parameters (see
+// `engine_parameters`).
+class material_table
+{
+public:
+  explicit material_table(unsigned = 8192);
+
+  const material_entry &probe(const state &);
+
+  void clear();
+
+private:
+  std::vector<material_entry> table_;
+};
+
+// Every thread has its own table (entries are lazily filled and threads
+// evaluating positions in parallel would otherwise race on them).
+extern thread_local material_table material_db;
+
+template<class P> material_entry make_material_entry(const state &,
+                                                    const P &);
+
+extern int phase256(const state &);
+
+}  // namespace testudo
+
+#endif  // include guard
@@ -15,7 +15,7 @@
 namespace testudo
 {
 
-mcts_state::mcts_state(const state &s) : state_(s)
+mcts_state::mcts_state(const state &s, eval_cache *ec) : state_(s), ec_(ec)
 {
 }
 
@@ -47,7 +47,7 @@ std::vector<double> mcts_state::eval() const
     break;
   }
 
-  double black_score(testudo::eval(state_));
+  double black_score(ec_ ? ec_->eval(state_) : testudo::eval(state_));
   if (state_.side() == WHITE)
     black_score = -black_score;
 
@@ -84,6 +84,8 @@ move mcts_search::run(bool verbose)
     return move::sentry();
 
   default:
+    if (ec_)
+      ec_->stats.reset();
     stats.reset();
   }
 
@@ -98,6 +100,9 @@ move mcts_search::run(bool verbose)
 
   const auto r(mcts(root_state_, p).run());
 
+  if (ec_)
+    stats.ec = ec_->stats;
+
   if (verbose)
   {
     testudoOUTPUT << 10 << ' ' << r.second[root_state_.get_state().side()]
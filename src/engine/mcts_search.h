@@ -22,7 +22,7 @@ class mcts_state
 public:
   using action = move;
 
-  explicit mcts_state(const state &);
+  explicit mcts_state(const state &, eval_cache * = nullptr);
 
   bool make_action(const action &);
   std::vector<action> actions() const;
@@ -36,24 +36,28 @@ public:
 
 private:
   state state_;
+  eval_cache *ec_;
 };
 
 class mcts_search : public search
 {
 public:
-  explicit mcts_search(const std::vector<state> &);
+  explicit mcts_search(const std::vector<state> &, eval_cache * = nullptr);
 
   move run(bool) final;
 
 private:
   mcts_state root_state_;
+  eval_cache *ec_;
 };  // class mcts_search
 
 // `states` is the sequence of states reached until now. It could be a partial
 // list (e.g. for FEN positions) but `states.back()` must contain the current
 // state.
-inline mcts_search::mcts_search(const std::vector<state> &states)
-  : search(), root_state_(states.back())
+// `ec` is a pointer to an external evaluation cache (optional).
+inline mcts_search::mcts_search(const std::vector<state> &states,
+                                eval_cache *ec)
+  : search(), root_state_(states.back(), ec), ec_(ec)
 {
   assert(!states.empty());
 }
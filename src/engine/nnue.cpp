@@ -0,0 +1,342 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#  include <immintrin.h>
+#endif
+
+#include "nnue.h"
+#include "endgame.h"
+#include "log.h"
+#include "random.h"
+#include "state.h"
+
+namespace testudo
+{
+
+namespace nnue
+{
+
+namespace
+{
+
+const char MAGIC[8] = {'T', 'S', 'T', 'D', 'N', 'N', 'U', 'E'};
+
+// Header of a weights file. The rest of the file contains the raw weights (in
+// the order they're declared in the `network` class).
+struct file_header
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t inputs;
+  std::uint32_t hidden;
+  std::uint32_t reserved;
+};
+
+std::uint32_t last_id(0);  // every set of weights gets a new identifier
+bool use_network(false);  // see `enable`
+
+// Index of the feature "piece `p` on square `s`" from the point of view of
+// side `perspective`.
+unsigned feature(color perspective, piece p, square s) noexcept
+{
+  const unsigned side(p.color() == perspective ? 0 : 6);
+  const square rel(perspective == WHITE ? s : flip(s));
+
+  return (side + p.type()) * 64 + rel;
+}
+
+// The result is kept below the recognized wins (`KNOWN_WIN`) and so far from
+// the mate scores: an evaluation mistaken for a mate would corrupt the search
+// (mate distance pruning, hash table score adjustments).
+score to_centipawns(std::int32_t sum) noexcept
+{
+  const auto v(static_cast<std::int64_t>(sum) * SCALE / (QA * QB));
+
+  return static_cast<score>(
+    std::max<std::int64_t>(-KNOWN_WIN + 1,
+                           std::min<std::int64_t>(KNOWN_WIN - 1, v)));
+}
+
+}  // unnamed namespace
+
+network net;
+
+bool network::load(const std::string &f)
+{
+  std::ifstream in(f, std::ios::binary);
+  if (!in)
+    return false;
+
+  file_header h;
+  if (!in.read(reinterpret_cast<char *>(&h), sizeof(h))
+      || std::memcmp(h.magic, MAGIC, sizeof(MAGIC))
+      || h.version != VERSION || h.inputs != INPUTS || h.hidden != HIDDEN)
+  {
+    testudoINFO << "Wrong or incompatible network file " << f;
+    return false;
+  }
+
+  // Reading into a temporary object keeps the current weights in case of
+  // error.
+  auto tmp(std::make_unique<network>());
+
+  if (!in.read(reinterpret_cast<char *>(tmp->ft_weights_),
+               sizeof(tmp->ft_weights_))
+      || !in.read(reinterpret_cast<char *>(tmp->ft_bias_),
+                  sizeof(tmp->ft_bias_))
+      || !in.read(reinterpret_cast<char *>(tmp->out_weights_),
+                  sizeof(tmp->out_weights_))
+      || !in.read(reinterpret_cast<char *>(&tmp->out_bias_),
+                  sizeof(tmp->out_bias_)))
+  {
+    testudoINFO << "Truncated network file " << f;
+    return false;
+  }
+
+  *this = *tmp;
+  id_ = ++last_id;
+
+  return true;
+}
+
+bool network::save(const std::string &f) const
+{
+  const std::string tmp_name(f + ".tmp");
+
+  {
+    std::ofstream out(tmp_name, std::ios::binary);
+    if (!out)
+      return false;
+
+    file_header h;
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = VERSION;
+    h.inputs = INPUTS;
+    h.hidden = HIDDEN;
+    h.reserved = 0;
+
+    if (!out.write(reinterpret_cast<const char *>(&h), sizeof(h))
+        || !out.write(reinterpret_cast<const char *>(ft_weights_),
+                      sizeof(ft_weights_))
+        || !out.write(reinterpret_cast<const char *>(ft_bias_),
+                      sizeof(ft_bias_))
+        || !out.write(reinterpret_cast<const char *>(out_weights_),
+                      sizeof(out_weights_))
+        || !out.write(reinterpret_cast<const char *>(&out_bias_),
+                      sizeof(out_bias_)))
+      return false;
+  }
+
+  return std::rename(tmp_name.c_str(), f.c_str()) == 0;
+}
+
+// Fills the network with random weights (first layer weights are in the
+// `[-range, range]` interval). Useful for testing and as a starting point for
+// training.
+void network::randomize(unsigned range)
+{
+  const int r(static_cast<int>(range));
+
+  for (auto &row : ft_weights_)
+    for (auto &w : row)
+      w = static_cast<std::int16_t>(random::between(-r, r));
+
+  for (auto &b : ft_bias_)
+    b = static_cast<std::int16_t>(random::between(-r, r));
+
+  for (auto &w : out_weights_)
+    w = static_cast<std::int8_t>(random::between(-QB, QB));
+
+  out_bias_ = 0;
+
+  id_ = ++last_id;
+}
+
+void network::reset(accumulator &acc) const noexcept
+{
+  std::copy(std::begin(ft_bias_), std::end(ft_bias_), acc.v[BLACK]);
+  std::copy(std::begin(ft_bias_), std::end(ft_bias_), acc.v[WHITE]);
+  acc.id = id_;
+}
+
+// The following loops are simple enough to be vectorized by the compiler.
+void network::add(accumulator &acc, piece p, square s) const noexcept
+{
+  for (color c : {BLACK, WHITE})
+  {
+    const auto *w(ft_weights_[feature(c, p, s)]);
+
+    for (unsigned i(0); i < HIDDEN; ++i)
+      acc.v[c][i] += w[i];
+  }
+}
+
+void network::sub(accumulator &acc, piece p, square s) const noexcept
+{
+  for (color c : {BLACK, WHITE})
+  {
+    const auto *w(ft_weights_[feature(c, p, s)]);
+
+    for (unsigned i(0); i < HIDDEN; ++i)
+      acc.v[c][i] -= w[i];
+  }
+}
+
+// Computes the accumulator from scratch.
+void network::refresh(const state &s, accumulator &acc) const noexcept
+{
+  reset(acc);
+
+  for (square i(0); i < 64; ++i)
+    if (s[i] != EMPTY)
+      add(acc, s[i], i);
+}
+
+// Output of the network (centipawns, from the point of view of side `stm`).
+score network::evaluate(const accumulator &acc, color stm) const noexcept
+{
+#if defined(__AVX2__)
+  const __m256i zero(_mm256_setzero_si256());
+  const __m256i qa(_mm256_set1_epi16(QA));
+  __m256i sum(_mm256_setzero_si256());
+
+  for (unsigned p(0); p < 2; ++p)
+  {
+    const std::int16_t *a(acc.v[p ? !stm : stm]);
+    const std::int8_t *w(out_weights_ + p * HIDDEN);
+
+    for (unsigned i(0); i < HIDDEN; i += 16)
+    {
+      __m256i x(_mm256_loadu_si256(
+                  reinterpret_cast<const __m256i *>(a + i)));
+      x = _mm256_min_epi16(_mm256_max_epi16(x, zero), qa);
+
+      const __m256i wv(_mm256_cvtepi8_epi16(
+                         _mm_loadu_si128(
+                           reinterpret_cast<const __m128i *>(w + i))));
+
+      sum = _mm256_add_epi32(sum, _mm256_madd_epi16(x, wv));
+    }
+  }
+
+  __m128i s(_mm_add_epi32(_mm256_castsi256_si128(sum),
+                          _mm256_extracti128_si256(sum, 1)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+
+  return to_centipawns(out_bias_ + _mm_cvtsi128_si32(s));
+#elif defined(__SSE2__)
+  const __m128i zero(_mm_setzero_si128());
+  const __m128i qa(_mm_set1_epi16(QA));
+  __m128i sum(_mm_setzero_si128());
+
+  for (unsigned p(0); p < 2; ++p)
+  {
+    const std::int16_t *a(acc.v[p ? !stm : stm]);
+    const std::int8_t *w(out_weights_ + p * HIDDEN);
+
+    for (unsigned i(0); i < HIDDEN; i += 8)
+    {
+      __m128i x(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+      x = _mm_min_epi16(_mm_max_epi16(x, zero), qa);
+
+      // Sign extension of eight int8 weights (SSE2 has no `cvtepi8`).
+      const __m128i w8(_mm_loadl_epi64(
+                         reinterpret_cast<const __m128i *>(w + i)));
+      const __m128i wv(_mm_srai_epi16(_mm_unpacklo_epi8(w8, w8), 8));
+
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(x, wv));
+    }
+  }
+
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+
+  return to_centipawns(out_bias_ + _mm_cvtsi128_si32(sum));
+#else
+  return evaluate_scalar(acc, stm);
+#endif
+}
+
+// Reference implementation of `evaluate` (same result).
+score network::evaluate_scalar(const accumulator &acc, color stm) const
+  noexcept
+{
+  std::int32_t sum(out_bias_);
+
+  for (unsigned p(0); p < 2; ++p)
+  {
+    const std::int16_t *a(acc.v[p ? !stm : stm]);
+    const std::int8_t *w(out_weights_ + p * HIDDEN);
+
+    for (unsigned i(0); i < HIDDEN; ++i)
+      sum += std::min<std::int32_t>(std::max<std::int32_t>(a[i], 0), QA)
+             * w[i];
+  }
+
+  return to_centipawns(sum);
+}
+
+bool enabled() noexcept
+{
+  return use_network;
+}
+
+// Selects the neural network (`true`) or the classical evaluation (`false`).
+// Returns `false` if the network has no weights.
+bool enable(bool on)
+{
+  if (on && !net.id())
+    return false;
+
+  use_network = on;
+  return true;
+}
+
+// Loads the weights from file `f` and selects the neural network evaluator.
+bool use(const std::string &f)
+{
+  if (!net.load(f) || !enable(true))
+  {
+    testudoINFO << "Cannot use neural network " << f;
+    return false;
+  }
+
+  testudoINFO << "Using neural network " << f;
+  return true;
+}
+
+// Evaluates a position with the current network (the state's accumulator is
+// used when available and up to date).
+score eval(const state &s)
+{
+  assert(net.id());
+
+#if defined(TESTUDO_NNUE)
+  if (s.accumulator().id == net.id())
+    return net.evaluate(s.accumulator(), s.side());
+#endif
+
+  accumulator acc;
+  net.refresh(s, acc);
+  return net.evaluate(acc, s.side());
+}
+
+}  // namespace nnue
+
+}  // namespace testudo
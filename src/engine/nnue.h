@@ -0,0 +1,111 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_NNUE_H)
+#define      TESTUDO_NNUE_H
+
+#include <cstdint>
+#include <string>
+
+#include "piece.h"
+
+namespace testudo
+{
+
+class state;
+
+// Efficiently updatable neural network (NNUE, Yu Nasu) evaluator.
+//
+// The network has two layers:
+// - a feature transformer (the large, sparse, first layer) mapping the
+//   `INPUTS` piece/square features to `HIDDEN` neurons. It's computed twice,
+//   once for each perspective (the features are relative to the side:
+//   "own"/"their" pieces, board vertically flipped for BLACK);
+// - an output layer reading the clipped (`[0, QA]`) activations of the side
+//   to move followed by the ones of the other side.
+//
+// A move changes only a few features, so the output of the first layer (the
+// accumulator) is updated incrementally adding / subtracting the weights of
+// the changed features. If the `TESTUDO_NNUE` macro is defined, every state
+// contains its own accumulator (updated by `state::fill_square` /
+// `state::clear_square`), otherwise the accumulator is computed from scratch
+// at every evaluation.
+//
+// Weights are quantized (int16 for the first layer, int8 for the output
+// layer) and the forward pass uses AVX2 / SSE2 instructions when available
+// (with a scalar fallback giving identical results).
+namespace nnue
+{
+
+constexpr unsigned INPUTS = 2 * 6 * 64;  // (own / their) x type x square
+constexpr unsigned HIDDEN = 128;
+
+constexpr int QA = 127;   // activation range of the hidden layer
+constexpr int QB = 64;    // scale of the output weights
+constexpr int SCALE = 400;  // network output to centipawn
+
+// NOTE
+// The accumulator is part of the `state` class and states are often
+// dynamically allocated: C++14 doesn't guarantee over-aligned allocations, so
+// the accumulator has no alignment requirement (unaligned loads are used).
+struct accumulator
+{
+  std::int16_t v[2][HIDDEN];  // one row for each perspective
+
+  std::uint32_t id = 0;  // network the accumulator refers to (see `network`)
+};
+
+class network
+{
+public:
+  static constexpr std::uint32_t VERSION = 1;
+
+  network() = default;
+
+  bool load(const std::string &);
+  bool save(const std::string &) const;
+
+  void randomize(unsigned = 64);
+
+  // Identifies the current set of weights (`0` if the network is empty).
+  std::uint32_t id() const noexcept { return id_; }
+
+  void reset(accumulator &) const noexcept;
+  void add(accumulator &, piece, square) const noexcept;
+  void sub(accumulator &, piece, square) const noexcept;
+  void refresh(const state &, accumulator &) const noexcept;
+
+  score evaluate(const accumulator &, color) const noexcept;
+  score evaluate_scalar(const accumulator &, color) const noexcept;
+
+private:
+  alignas(32) std::int16_t ft_weights_[INPUTS][HIDDEN] = {};
+  alignas(32) std::int16_t ft_bias_[HIDDEN] = {};
+  alignas(32) std::int8_t out_weights_[2 * HIDDEN] = {};
+  std::int32_t out_bias_ = 0;
+
+  std::uint32_t id_ = 0;
+};
+
+extern network net;
+
+// Selection of the evaluator (see `testudo::eval`). The neural network can be
+// used only after loading some weights.
+bool enabled() noexcept;
+bool enable(bool);
+bool use(const std::string &);
+
+score eval(const state &);
+
+}  // namespace nnue
+
+}  // namespace testudo
+
+#endif  // include guard
@@ -9,14 +9,27 @@
  */
 
 #if defined(UNIX)
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <stdlib.h>
 #  include <unistd.h>
+#  include <sys/file.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
 #  include <sys/time.h>
 #  include <sys/types.h>
 #elif defined(WIN32)
+#  include <malloc.h>
 #  include <sys/timeb.h>
 #  include <windows.h>
 #endif
 
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
 #include "nonstd.h"
 
 namespace testudo
@@ -63,4 +76,257 @@ bool input_available()
 #endif
 }
 
+large_memory::large_memory(std::size_t size)
+  : ptr_(nullptr), size_(size), fd_(-1), mapped_(false)
+{
+  constexpr std::size_t cache_line = 64;
+
+#if defined(UNIX)
+  // Huge pages are usually 2MB: rounding the size allows the kernel to back
+  // the whole block with them.
+  constexpr std::size_t huge_page = 2 * 1024 * 1024;
+  if (size_ >= huge_page)
+    size_ = (size_ + huge_page - 1) / huge_page * huge_page;
+
+  void *p(mmap(nullptr, size_, PROT_READ|PROT_WRITE,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0));
+  if (p != MAP_FAILED)
+  {
+#  if defined(MADV_HUGEPAGE)
+    madvise(p, size_, MADV_HUGEPAGE);
+#  endif
+    ptr_ = p;
+    mapped_ = true;
+    return;
+  }
+
+  if (posix_memalign(&ptr_, cache_line, size_))
+    ptr_ = nullptr;
+#elif defined(WIN32)
+  ptr_ = _aligned_malloc(size_, cache_line);
+#else
+#  error Missing implementation of the large_memory class
+#endif
+
+  if (!ptr_)
+    throw std::bad_alloc();
+}
+
+// Throws `std::runtime_error` if the file cannot be read.
+large_memory::large_memory(const std::string &file)
+  : ptr_(nullptr), size_(0), fd_(-1), mapped_(false)
+{
+#if defined(UNIX)
+  const int fd(open(file.c_str(), O_RDONLY));
+  if (fd == -1)
+    throw std::runtime_error("Cannot open " + file);
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void *p(mmap(nullptr, st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd,
+                 0));
+    if (p != MAP_FAILED)
+    {
+      ptr_ = p;
+      size_ = st.st_size;
+      mapped_ = true;
+    }
+  }
+
+  close(fd);  // the mapping keeps its own reference to the file
+
+  if (!ptr_)
+    throw std::runtime_error("Cannot map " + file);
+#else
+  std::ifstream in(file, std::ios::binary | std::ios::ate);
+  if (!in)
+    throw std::runtime_error("Cannot open " + file);
+
+  *this = large_memory(static_cast<std::size_t>(in.tellg()));
+  in.seekg(0);
+  if (!in.read(static_cast<char *>(ptr_), size_))
+    throw std::runtime_error("Cannot read " + file);
+#endif
+}
+
+// Maps the POSIX shared memory segment `name`. If the segment doesn't exist
+// it's created with the given `size` (its content is zero-filled) and
+// `*created` is set to `true`. Otherwise the existing segment is mapped with
+// its own size.
+// The creator gets the segment locked exclusively: it should initialize the
+// content and then call `lock_shared`. The other processes get a shared lock
+// (waiting for the creator to finish). The last process detaching is the only
+// one able to `try_lock_exclusive` and remove the segment.
+// A segment left unsized by a crashed creator is removed and created again.
+// Throws `std::runtime_error` in case of failure.
+large_memory large_memory::shared(const std::string &name, std::size_t size,
+                                  bool *created)
+{
+#if defined(UNIX)
+  using namespace std::chrono_literals;
+
+  for (unsigned i(0); i < 500; ++i)
+  {
+    *created = true;
+    int fd(shm_open(name.c_str(), O_RDWR|O_CREAT|O_EXCL, 0600));
+    if (fd == -1 && errno == EEXIST)
+    {
+      *created = false;
+      fd = shm_open(name.c_str(), O_RDWR, 0600);
+      if (fd == -1 && errno == ENOENT)  // removed in the meantime
+        continue;
+    }
+
+    if (fd == -1)
+      throw std::runtime_error("Cannot open shared memory " + name);
+
+    struct stat st;
+    if (flock(fd, *created ? LOCK_EX : LOCK_SH) == -1
+        || fstat(fd, &st) == -1)
+    {
+      close(fd);
+      if (*created)
+        remove_shared(name);
+      throw std::runtime_error("Cannot lock shared memory " + name);
+    }
+
+    if (*created)
+    {
+      if (ftruncate(fd, size) == -1)
+        size = 0;
+    }
+    else
+    {
+      // Removed by the last detaching process before we could lock it.
+      if (st.st_nlink == 0)
+      {
+        close(fd);
+        continue;
+      }
+
+      // The creator hasn't sized the segment yet (it has still to lock it)
+      // or it died before doing so.
+      if (st.st_size == 0)
+      {
+        if (i >= 100 && flock(fd, LOCK_EX|LOCK_NB) == 0)
+          remove_shared(name);
+        close(fd);
+        std::this_thread::sleep_for(10ms);
+        continue;
+      }
+
+      size = st.st_size;
+    }
+
+    void *p(size ? mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd,
+                        0)
+                 : MAP_FAILED);
+
+    if (p == MAP_FAILED)
+    {
+      close(fd);
+      if (*created)
+        remove_shared(name);
+      throw std::runtime_error("Cannot map shared memory " + name);
+    }
+
+    // The descriptor is kept open: it holds the lock.
+    large_memory ret;
+    ret.ptr_ = p;
+    ret.size_ = size;
+    ret.fd_ = fd;
+    ret.mapped_ = true;
+    return ret;
+  }
+
+  throw std::runtime_error("Cannot attach to shared memory " + name);
+#else
+  (void)size;
+  *created = false;
+  throw std::runtime_error("Shared memory not supported (" + name + ")");
+#endif
+}
+
+// Turns the lock on a shared memory segment into a shared lock (e.g. the
+// creator has finished the initialization).
+bool large_memory::lock_shared() noexcept
+{
+#if defined(UNIX)
+  return fd_ != -1 && flock(fd_, LOCK_SH) == 0;
+#else
+  return false;
+#endif
+}
+
+// Tries to lock a shared memory segment exclusively: it succeeds only if no
+// other process is attached. The previous lock is lost even on failure (the
+// conversion isn't atomic).
+bool large_memory::try_lock_exclusive() noexcept
+{
+#if defined(UNIX)
+  return fd_ != -1 && flock(fd_, LOCK_EX|LOCK_NB) == 0;
+#else
+  return false;
+#endif
+}
+
+// Removes the name of a shared memory segment: the memory is released when
+// all the processes have unmapped it.
+void large_memory::remove_shared(const std::string &name) noexcept
+{
+#if defined(UNIX)
+  shm_unlink(name.c_str());
+#else
+  (void)name;
+#endif
+}
+
+large_memory::large_memory(large_memory &&o) noexcept
+  : ptr_(o.ptr_), size_(o.size_), fd_(o.fd_), mapped_(o.mapped_)
+{
+  o.ptr_ = nullptr;
+  o.size_ = 0;
+  o.fd_ = -1;
+  o.mapped_ = false;
+}
+
+large_memory &large_memory::operator=(large_memory &&o) noexcept
+{
+  if (this != &o)
+  {
+    release();
+
+    std::swap(ptr_, o.ptr_);
+    std::swap(size_, o.size_);
+    std::swap(fd_, o.fd_);
+    std::swap(mapped_, o.mapped_);
+  }
+
+  return *this;
+}
+
+void large_memory::release() noexcept
+{
+  if (!ptr_)
+    return;
+
+#if defined(UNIX)
+  if (mapped_)
+    munmap(ptr_, size_);
+  else
+    free(ptr_);
+
+  if (fd_ != -1)
+    close(fd_);  // releases the lock on a shared memory segment
+#elif defined(WIN32)
+  _aligned_free(ptr_);
+#endif
+
+  ptr_ = nullptr;
+  size_ = 0;
+  fd_ = -1;
+  mapped_ = false;
+}
+
 }  // namespace testudo
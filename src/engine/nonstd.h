@@ -11,11 +11,90 @@
 #if !defined(TESTUDO_NONSTD_H)
 #define      TESTUDO_NONSTD_H
 
+#include <cassert>
+#include <cstddef>
+#include <string>
+
 namespace testudo
 {
 
 bool input_available();
 
+// A large block of memory (e.g. for the transposition table).
+// On UNIX systems memory is obtained via `mmap` and, when available,
+// transparent huge pages are requested to reduce TLB misses. Otherwise (or if
+// `mmap` fails) cache line aligned heap memory is used.
+// Memory content is unspecified.
+// A block can also be initialized with the content of a file: on UNIX systems
+// the file is mapped copy-on-write (pages are read lazily and changes are
+// never written back), elsewhere it's read into heap memory.
+// Lastly a block can be a named shared memory segment (UNIX only) accessible
+// by multiple processes. Every process attached to a segment holds a lock on
+// it (see `shared`): locks are released by the kernel when a process ends,
+// so they work as a reference count surviving crashes.
+class large_memory
+{
+public:
+  large_memory() noexcept
+    : ptr_(nullptr), size_(0), fd_(-1), mapped_(false) {}
+  explicit large_memory(std::size_t);
+  explicit large_memory(const std::string &);
+  ~large_memory() { release(); }
+
+  large_memory(const large_memory &) = delete;
+  large_memory &operator=(const large_memory &) = delete;
+  large_memory(large_memory &&) noexcept;
+  large_memory &operator=(large_memory &&) noexcept;
+
+  static large_memory shared(const std::string &, std::size_t, bool *);
+  static void remove_shared(const std::string &) noexcept;
+  bool lock_shared() noexcept;
+  bool try_lock_exclusive() noexcept;
+
+  void *get() const noexcept { return ptr_; }
+  std::size_t size() const noexcept { return size_; }
+
+private:
+  void release() noexcept;
+
+  void *ptr_;
+  std::size_t size_;
+  int fd_;       // descriptor of a shared memory segment (`-1` otherwise)
+  bool mapped_;  // `true` if memory comes from `mmap`
+};
+
+// A non-owning view over a contiguous sequence of objects (a minimal subset
+// of the C++20 `std::span` class).
+template<class T>
+class span
+{
+public:
+  constexpr span() noexcept : data_(nullptr), size_(0) {}
+  constexpr span(T *d, std::size_t n) noexcept : data_(d), size_(n) {}
+  template<class C> constexpr span(C &c) noexcept
+    : data_(c.data()), size_(c.size()) {}
+
+  constexpr T *data() const noexcept { return data_; }
+  constexpr std::size_t size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+
+  constexpr T *begin() const noexcept { return data_; }
+  constexpr T *end() const noexcept { return data_ + size_; }
+
+  constexpr T &operator[](std::size_t i) const noexcept
+  { assert(i < size_);  return data_[i]; }
+
+  constexpr span subspan(std::size_t offset, std::size_t count) const noexcept
+  {
+    assert(offset + count <= size_);
+    return span(data_ + offset, count);
+  }
+
+private:
+  T *data_;
+  std::size_t size_;
+};
+
 }  // namespace testudo
 
 #endif  // include guard
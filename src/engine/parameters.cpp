@@ -32,11 +32,19 @@ void clamp(T &v, T lo, T hi)
 
 }  // unnamed namespace
 
-const std::string parameters::pawn::sec_name   =   "pawn";
-const std::string parameters::pcsq::sec_name   =   "pcsq";
-const std::string parameters::pp_adj::sec_name = "pp_adj";
+const std::string parameters::activity::sec_name = "activity";
+const std::string parameters::pawn::sec_name     =     "pawn";
+const std::string parameters::pcsq::sec_name     =     "pcsq";
+const std::string parameters::pp_adj::sec_name   =   "pp_adj";
 
+constexpr parameters::builtin_t parameters::builtin;
+constexpr parameters baked_parameters::values;
+
+#if defined(TESTUDO_CONSTEXPR_PARAMETERS)
+parameters db(parameters::builtin);
+#else
 parameters db;
+#endif
 
 parameters::parameters()
 {
@@ -45,9 +53,17 @@ parameters::parameters()
     testudoINFO << "Using default values for some/all parameters";
   }
 
-  pawn_.init();
-  pcsq_.init();
-  pp_adj_.init();
+  init();
+}
+
+// Parameters taken from a JSON object with the structure of the
+// `testudo.json` file (e.g. the output of `save(nlohmann::json &)`). Useful
+// to build many sets of parameters without touching the global `db` (see the
+// tuner).
+parameters::parameters(const nlohmann::json &j)
+{
+  load(j);
+  init();
 }
 
 bool parameters::load()
@@ -60,6 +76,11 @@ bool parameters::load()
   if (!(f >> j))
     return false;
 
+  return load(j);
+}
+
+bool parameters::load(const nlohmann::json &j)
+{
   bool ret(true);
 
   if (!pcsq_.load(j))
@@ -91,13 +112,18 @@ bool parameters::load()
     ret =  false;
   }
 
+  if (!activity_.load(j))
+  {
+    testudoWARNING << "Partial initialization of the parameters "
+                      "(missing 'activity' section)";
+    ret = false;
+  }
+
   return ret;
 }
 
-bool parameters::save() const
+void parameters::save(nlohmann::json &j) const
 {
-  nlohmann::json j;
-
   pcsq_.save(j);
 
   j["material"]["bishop_pair"] = bishop_pair_;
@@ -108,62 +134,16 @@ bool parameters::save() const
 
   pawn_.save(j);
 
-  std::ofstream f("testudo.json");
-  return !!f && f << j;
+  activity_.save(j);
 }
 
-void parameters::pawn::init()
+bool parameters::save() const
 {
-  const auto scale([](int y_min, int y_max, int x_min, int x_max, int x)
-                   {
-                     assert(y_min <= y_max);
-                     assert(x_min < x_max);
-                     assert(x_min <= x && x <= x_max);
-
-                     const auto dy(y_max - y_min), dx(x_max - x_min);
-                     return (dy * (x - x_min) + y_min * dx) / dx;
-                   });
-
-  passed_e[0] = passed_m[0] = 0;  // not used - just for security
-
-  for (int r(1); r < 7; ++r)
-  {
-    passed_e[r] = scale(passed_min_e, passed_max_e, 1, 6, r);
-    passed_m[r] = scale(passed_min_m, passed_max_m, 1, 6, r);
-
-    protected_passed_e[r] = passed_e[r] * protected_passed_perc / 100;
-  }
-  assert(passed_e[6] == passed_max_e);
-  assert(passed_e[1] == passed_min_e);
-  assert(passed_m[6] == passed_max_m);
-  assert(passed_m[1] == passed_min_m);
-  assert(protected_passed_e[6] == passed_max_e * protected_passed_perc / 100);
-  assert(protected_passed_e[1] == passed_min_e * protected_passed_perc / 100);
-
-  for (unsigned f(0); f < 8; ++f)
-  {
-    const auto dist(f >= FILE_E ? FILE_H - f : f - FILE_A);
-
-    weak_e[f] = scale(weak_min_e, weak_max_e, 0, 3, dist);
-    weak_m[f] = scale(weak_min_m, weak_max_m, 0, 3, dist);
-
-    weak_open_e[f] = weak_e[f] * weak_open_perc / 100;
-    weak_open_m[f] = weak_m[f] * weak_open_perc / 100;
-  }
+  nlohmann::json j;
+  save(j);
 
-  assert(weak_e[FILE_A] == weak_e[FILE_H]);
-  assert(weak_m[FILE_A] == weak_m[FILE_H]);
-  assert(weak_open_e[FILE_A] == weak_open_e[FILE_H]);
-  assert(weak_open_m[FILE_A] == weak_open_m[FILE_H]);
-
-  assert(weak_e[FILE_A] == weak_min_e);
-  assert(weak_m[FILE_A] == weak_min_m);
-  assert(weak_e[FILE_D] == weak_max_e);
-  assert(weak_m[FILE_D] == weak_max_m);
-  assert(weak_open_e[FILE_A] = weak_min_e * weak_open_perc / 100);
-  assert(weak_open_m[FILE_A] = weak_min_m * weak_open_perc / 100);
-  assert(weak_open_e[FILE_D] = weak_max_e * weak_open_perc / 100);
-  assert(weak_open_m[FILE_D] = weak_max_m * weak_open_perc / 100);
+  std::ofstream f("testudo.json");
+  return !!f && f << j;
 }
 
 bool parameters::pawn::load(const nlohmann::json &j)
@@ -240,209 +220,6 @@ void parameters::pawn::save(nlohmann::json &j) const
   j[sec_name]["weak_open_perc"] = weak_open_perc;
 }
 
-// The general idea comes from Fruit.
-void parameters::pcsq::init()
-{
-  // # PAWNS
-  // ## File
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    mg[WPAWN.id()][i] += pawn_file_base[f] * pawn_file_mult_m;
-  }
-
-  // ## Centre control
-  mg[WPAWN.id()][D3] += 10;
-  mg[WPAWN.id()][E3] += 10;
-
-  mg[WPAWN.id()][D4] += 20;
-  mg[WPAWN.id()][E4] += 20;
-
-  mg[WPAWN.id()][D5] += 10;
-  mg[WPAWN.id()][E5] += 10;
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WPAWN.id()][i] *= pawn_weight;
-    mg[WPAWN.id()][i] /=         100;
-
-    eg[WPAWN.id()][i] *= pawn_weight;
-    eg[WPAWN.id()][i] /=         100;
-  }
-
-  // # KNIGHTS
-  // ## Centre
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
-
-    const auto knight_centre(knight_centre_base[f] + knight_centre_base[r]);
-
-    mg[WKNIGHT.id()][i] += knight_centre * knight_centre_mult_m;
-    eg[WKNIGHT.id()][i] += knight_centre * knight_centre_mult_e;
-  }
-
-  // ## Rank
-  for (square i(0); i < 64; ++i)
-    mg[WKNIGHT.id()][i] += knight_rank_base[rank(i)] * knight_rank_mult_m;
-
-  // ## Back rank
-  for (square i(A1); i <= H1; ++i)
-    mg[WKNIGHT.id()][i] -= knight_backrank_base_m;
-
-  // ## "Trapped"
-  mg[WKNIGHT.id()][A8] -= knight_trapped_base_m;
-  mg[WKNIGHT.id()][H8] -= knight_trapped_base_m;
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WKNIGHT.id()][i] *= piece_weight;
-    mg[WKNIGHT.id()][i] /=          100;
-
-    eg[WKNIGHT.id()][i] *= piece_weight;
-    eg[WKNIGHT.id()][i] /=          100;
-  }
-
-  // # BISHOPS
-  // ## Centre
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
-
-    const auto bishop_centre(bishop_centre_base[f] + bishop_centre_base[r]);
-
-    mg[WBISHOP.id()][i] += bishop_centre * bishop_centre_mult_m;
-
-    eg[WBISHOP.id()][i] += bishop_centre * bishop_centre_mult_e;
-  }
-
-  // ## Back rank
-  for (square i(A1); i <= H1; ++i)
-    mg[WBISHOP.id()][i] -= bishop_backrank_base_m;
-
-  // ## Main diagonals
-  mg[WBISHOP.id()][A1] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][B2] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][C3] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][D4] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][E5] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][F6] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][G7] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][H8] += bishop_diagonal_base_m;
-
-  mg[WBISHOP.id()][H1] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][G2] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][F3] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][E4] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][D5] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][C6] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][B7] += bishop_diagonal_base_m;
-  mg[WBISHOP.id()][A8] += bishop_diagonal_base_m;
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WBISHOP.id()][i] *= piece_weight;
-    mg[WBISHOP.id()][i] /=          100;
-
-    eg[WBISHOP.id()][i] *= piece_weight;
-    eg[WBISHOP.id()][i] /=          100;
-  }
-
-  // # ROOKS
-  // ## File
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    mg[WROOK.id()][i] += rook_file_base[f] * rook_file_mult_m;
-  }
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WROOK.id()][i] *= piece_weight;
-    mg[WROOK.id()][i] /=          100;
-
-    eg[WROOK.id()][i] *= piece_weight;
-    eg[WROOK.id()][i] /=          100;
-  }
-
-  // # QUEENS
-  // ## Centre
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
-
-    const auto queen_centre(queen_centre_base[f] + queen_centre_base[r]);
-
-    mg[WQUEEN.id()][i] += queen_centre * queen_centre_mult_m;
-    eg[WQUEEN.id()][i] += queen_centre * queen_centre_mult_e;
-  }
-
-  // ## Back rank
-  for (square i(A1); i <= H1; ++i)
-    mg[WQUEEN.id()][i] -= queen_backrank_base_m;
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WQUEEN.id()][i] *= piece_weight;
-    mg[WQUEEN.id()][i] /=          100;
-
-    eg[WQUEEN.id()][i] *= piece_weight;
-    eg[WQUEEN.id()][i] /=          100;
-  }
-
-  // # KINGS
-  // ## Centre
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
-
-    const auto king_centre(king_centre_base[f] + king_centre_base[r]);
-
-    eg[WKING.id()][i] += king_centre * king_centre_mult_e;
-  }
-
-  // ## File
-  for (square i(0); i < 64; ++i)
-  {
-    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
-    mg[WKING.id()][i] += king_file_base[f] * king_file_mult_m;
-  }
-
-  // ## Rank
-  for (square i(0); i < 64; ++i)
-    mg[WKING.id()][i] += king_rank_base[rank(i)] * king_rank_mult_m;
-
-  // ## Weight
-  for (square i(0); i < 64; ++i)
-  {
-    mg[WKING.id()][i] *= king_weight;
-    mg[WKING.id()][i] /=         100;
-
-    eg[WKING.id()][i] *= piece_weight;
-    eg[WKING.id()][i] /=          100;
-  }
-
-  // Flipped copy for BLACK.
-  for (unsigned t(piece::pawn); t <= piece::queen; ++t)
-    for (square i(0); i < 64; ++i)
-    {
-      const auto pb(piece(BLACK, t).id());
-      const auto pw(piece(WHITE, t).id());
-
-      eg[pb][flip(i)] = eg[pw][i];
-      mg[pb][flip(i)] = mg[pw][i];
-    }
-}
-
 bool parameters::pcsq::load(const nlohmann::json &j)
 {
   pawn_file_base         = j[sec_name]["pawn_file_base"];
@@ -500,8 +277,6 @@ bool parameters::pcsq::load(const nlohmann::json &j)
   clamp(      king_file_mult_m, 1, 20);
   clamp(      king_rank_mult_m, 1, 20);
 
-  std::cout << "Value at load: " << queen_centre_mult_m << std::endl;
-
   clamp(knight_backrank_base_m, 0,  20);
   clamp( knight_trapped_base_m, 0, 120);
   clamp(bishop_backrank_base_m, 0,  20);
@@ -546,17 +321,6 @@ void parameters::pcsq::save(nlohmann::json &j) const
   j[sec_name]["king_weight"]            = king_weight;
 }
 
-void parameters::pp_adj::init()
-{
-  n[0] = knight_wo_pawns_base;
-  r[0] =   rook_wo_pawns_base;
-  for (int i(1); i < 9; ++i)
-  {
-    n[i] = n[0] + knight_wo_pawns_d * i;
-    r[i] = n[0] +   rook_wo_pawns_d * i;
-  }
-}
-
 bool parameters::pp_adj::load(const nlohmann::json &j)
 {
   knight_wo_pawns_base = j[sec_name]["knight_wo_pawns_base"];
@@ -582,4 +346,61 @@ void parameters::pp_adj::save(nlohmann::json &j) const
   j[sec_name][  "rook_wo_pawns_d"] =   rook_wo_pawns_d;
 }
 
+bool parameters::activity::load(const nlohmann::json &j)
+{
+  // Parameter files written before the introduction of the section.
+  if (j.find(sec_name) == j.end())
+    return false;
+
+  knight_mobility_mult_e = j[sec_name]["knight_mobility_mult_e"];
+  knight_mobility_mult_m = j[sec_name]["knight_mobility_mult_m"];
+  bishop_mobility_mult_e = j[sec_name]["bishop_mobility_mult_e"];
+  bishop_mobility_mult_m = j[sec_name]["bishop_mobility_mult_m"];
+  rook_mobility_mult_e   = j[sec_name][  "rook_mobility_mult_e"];
+  rook_mobility_mult_m   = j[sec_name][  "rook_mobility_mult_m"];
+  queen_mobility_mult_e  = j[sec_name][ "queen_mobility_mult_e"];
+  queen_mobility_mult_m  = j[sec_name][ "queen_mobility_mult_m"];
+
+  knight_attack_base = j[sec_name]["knight_attack_base"];
+  bishop_attack_base = j[sec_name]["bishop_attack_base"];
+  rook_attack_base   = j[sec_name][  "rook_attack_base"];
+  queen_attack_base  = j[sec_name][ "queen_attack_base"];
+  double_attack_base = j[sec_name]["double_attack_base"];
+
+  clamp(knight_mobility_mult_e, 0, 10);
+  clamp(knight_mobility_mult_m, 0, 10);
+  clamp(bishop_mobility_mult_e, 0, 10);
+  clamp(bishop_mobility_mult_m, 0, 10);
+  clamp(  rook_mobility_mult_e, 0, 10);
+  clamp(  rook_mobility_mult_m, 0, 10);
+  clamp( queen_mobility_mult_e, 0, 10);
+  clamp( queen_mobility_mult_m, 0, 10);
+
+  clamp(knight_attack_base, 0, 20);
+  clamp(bishop_attack_base, 0, 20);
+  clamp(  rook_attack_base, 0, 20);
+  clamp( queen_attack_base, 0, 20);
+  clamp(double_attack_base, 0, 20);
+
+  return true;
+}
+
+void parameters::activity::save(nlohmann::json &j) const
+{
+  j[sec_name]["knight_mobility_mult_e"] = knight_mobility_mult_e;
+  j[sec_name]["knight_mobility_mult_m"] = knight_mobility_mult_m;
+  j[sec_name]["bishop_mobility_mult_e"] = bishop_mobility_mult_e;
+  j[sec_name]["bishop_mobility_mult_m"] = bishop_mobility_mult_m;
+  j[sec_name][  "rook_mobility_mult_e"] =   rook_mobility_mult_e;
+  j[sec_name][  "rook_mobility_mult_m"] =   rook_mobility_mult_m;
+  j[sec_name][ "queen_mobility_mult_e"] =  queen_mobility_mult_e;
+  j[sec_name][ "queen_mobility_mult_m"] =  queen_mobility_mult_m;
+
+  j[sec_name]["knight_attack_base"] = knight_attack_base;
+  j[sec_name]["bishop_attack_base"] = bishop_attack_base;
+  j[sec_name][  "rook_attack_base"] =   rook_attack_base;
+  j[sec_name][ "queen_attack_base"] =  queen_attack_base;
+  j[sec_name]["double_attack_base"] = double_attack_base;
+}
+
 }  // namespace testudo
@@ -11,6 +11,8 @@
 #if !defined(TESTUDO_PARAMETERS_H)
 #define      TESTUDO_PARAMETERS_H
 
+#include <cassert>
+
 #include "piece.h"
 #include "score.h"
 #include "thirdparty/json.hpp"
@@ -21,53 +23,69 @@ namespace testudo
 class parameters
 {
 public:
+  // Tag selecting the built-in values (the ones written below, not the
+  // content of `testudo.json`).
+  struct builtin_t {};
+  static constexpr builtin_t builtin = {};
+
   parameters();
+  explicit parameters(const nlohmann::json &);
+  constexpr explicit parameters(builtin_t);
 
-  score pcsq_e(piece p, square s) const
-  {
-    assert(p.id() < piece::sup_id);
-    assert(0 <= s && s < 64);
-    return pcsq_.eg[p.id()][s];
-  }
-  score pcsq_m(piece p, square s) const
+  constexpr packed_score pcsq(piece p, square s) const
   {
     assert(p.id() < piece::sup_id);
     assert(0 <= s && s < 64);
-    return pcsq_.mg[p.id()][s];
+    return pcsq_.packed[p.id()][s];
   }
 
-  score bishop_pair() const noexcept { return bishop_pair_; }
-  score knight_pair() const noexcept { return knight_pair_; }
-  score rook_pair() const noexcept { return rook_pair_; }
+  constexpr score bishop_pair() const noexcept { return bishop_pair_; }
+  constexpr score knight_pair() const noexcept { return knight_pair_; }
+  constexpr score rook_pair() const noexcept { return rook_pair_; }
 
-  score n_adj(unsigned pawns) const
+  constexpr score n_adj(unsigned pawns) const
   { assert(pawns < 9);  return pp_adj_.n[pawns]; }
-  score r_adj(unsigned pawns) const
+  constexpr score r_adj(unsigned pawns) const
   { assert(pawns < 9);  return pp_adj_.r[pawns]; }
 
-  score pawn_shield1() const noexcept { return pawn_.shield1; }
-  score pawn_shield2() const noexcept { return pawn_.shield2; }
-  score pawn_doubled_e() const noexcept { return pawn_.doubled_e; }
-  score pawn_doubled_m() const noexcept { return pawn_.doubled_m; }
-  score pawn_passed_e(unsigned r) const
-  { assert(r && r < 7);  return pawn_.passed_e[r]; }
-  score pawn_passed_m(unsigned r) const
-  { assert(r && r < 7);  return pawn_.passed_m[r]; }
-  score pawn_protected_passed_e(unsigned r) const
-  { assert(r && r < 7);  return pawn_.protected_passed_e[r]; }
-  score pawn_weak_e(unsigned f) const
+  constexpr score pawn_shield1() const noexcept { return pawn_.shield1; }
+  constexpr score pawn_shield2() const noexcept { return pawn_.shield2; }
+  constexpr packed_score pawn_doubled() const noexcept
+  { return pawn_.doubled; }
+  constexpr packed_score pawn_passed(unsigned r) const
+  { assert(r && r < 7);  return pawn_.passed[r]; }
+  constexpr packed_score pawn_protected_passed(unsigned r) const
+  { assert(r && r < 7);  return pawn_.protected_passed[r]; }
+  constexpr score pawn_weak_e(unsigned f) const
   { assert(f < 8);  return -pawn_.weak_e[f]; }
-  score pawn_weak_m(unsigned f) const
+  constexpr score pawn_weak_m(unsigned f) const
   { assert(f < 8);  return -pawn_.weak_m[f]; }
-  score pawn_weak_open_e(unsigned f) const
+  constexpr score pawn_weak_open_e(unsigned f) const
   { assert(f < 8);  return -pawn_.weak_open_e[f]; }
-  score pawn_weak_open_m(unsigned f) const
+  constexpr score pawn_weak_open_m(unsigned f) const
   { assert(f < 8);  return -pawn_.weak_open_m[f]; }
 
+  constexpr packed_score mobility(enum piece::type t, unsigned n) const
+  {
+    assert(piece::knight <= t && t <= piece::queen);
+    assert(n < 28);
+    return activity_.mobility[t][n];
+  }
+  constexpr score king_attack(enum piece::type t) const
+  {
+    assert(piece::knight <= t && t <= piece::queen);
+    return activity_.king_attack[t];
+  }
+  constexpr score king_attack2() const noexcept
+  { return activity_.king_attack2; }
+
   bool save() const;
+  void save(nlohmann::json &) const;
 
 private:
+  constexpr void init();
   bool load();
+  bool load(const nlohmann::json &);
 
   // Naming conventions:
   // 1. piece type (`pawn_`, `knight_`...)
@@ -77,7 +95,7 @@ private:
   //    parameter isn't phase specific
   struct pcsq
   {
-    void init();
+    constexpr void init();
     bool load(const nlohmann::json &);
     void save(nlohmann::json &) const;
 
@@ -86,8 +104,11 @@ private:
     // They're calculated starting from the other `pcsq_` data member. This
     // approach allows to have a more narrow set of variables subject to
     // optimization.
-    score mg[piece::sup_id][64];
-    score eg[piece::sup_id][64];
+    score mg[piece::sup_id][64] = {};
+    score eg[piece::sup_id][64] = {};
+
+    // The `mg` and `eg` tables packed together (used by the evaluation).
+    packed_score packed[piece::sup_id][64];
 
   private:
     static const std::string sec_name;
@@ -133,12 +154,12 @@ private:
   // Adjustements of piece value based on the number of remaining pawns.
   struct pp_adj
   {
-    void init();
+    constexpr void init();
     bool load(const nlohmann::json &);
     void save(nlohmann::json &) const;
 
-    score n[9];
-    score r[9];
+    score n[9] = {};
+    score r[9] = {};
 
   private:
     static const std::string sec_name;
@@ -153,7 +174,7 @@ private:
   // Pawn-related scores.
   struct pawn
   {
-    void init();
+    constexpr void init();
     bool load(const nlohmann::json &);
     void save(nlohmann::json &) const;
 
@@ -164,19 +185,22 @@ private:
     score doubled_e = -20;  // [      -30; 0]
     score doubled_m =  -8;  // [doubled_e; 0]
 
-    score passed_e[7];
-    score passed_m[7];
+    score weak_e[8] = {};
+    score weak_m[8] = {};
+    score weak_open_e[8] = {};
+    score weak_open_m[8] = {};
 
-    score protected_passed_e[7];
-
-    score weak_e[8];
-    score weak_m[8];
-    score weak_open_e[8];
-    score weak_open_m[8];
+    // Packed versions of the mid-game / end-game scores (for passed pawns
+    // the protection affects only the end-game).
+    packed_score doubled;
+    packed_score passed[7];
+    packed_score protected_passed[7];
 
   private:
     static const std::string sec_name;
 
+    static constexpr int scale(int, int, int, int, int);
+
     score passed_min_e =  20;           // [passed_min_m; 100]
     score passed_max_e = 140;           // [passed_min_e; 200]
 
@@ -193,10 +217,408 @@ private:
 
     score weak_open_perc = 130;         // [100; 200]
   } pawn_;
+
+  // Piece activity: mobility and attacks to the enemy king (see
+  // `attack_map`).
+  struct activity
+  {
+    constexpr void init();
+    bool load(const nlohmann::json &);
+    void save(nlohmann::json &) const;
+
+    // Bonus for a piece attacking `n` squares not occupied by friendly
+    // pieces nor attacked by enemy pawns (`mobility[type][n]`).
+    packed_score mobility[piece::queen + 1][28] = {};
+
+    // Bonus (mid-game only) for every square of the enemy king zone attacked
+    // by a piece type / attacked at least twice.
+    score king_attack[piece::queen + 1] = {};
+    score king_attack2 = 0;
+
+  private:
+    static const std::string sec_name;
+
+    score knight_mobility_mult_e = 4;  // [0; 10]
+    score knight_mobility_mult_m = 4;
+    score bishop_mobility_mult_e = 5;
+    score bishop_mobility_mult_m = 5;
+    score rook_mobility_mult_e   = 4;
+    score rook_mobility_mult_m   = 2;
+    score queen_mobility_mult_e  = 2;
+    score queen_mobility_mult_m  = 1;
+
+    score knight_attack_base = 6;      // [0; 20]
+    score bishop_attack_base = 4;
+    score rook_attack_base   = 6;
+    score queen_attack_base  = 8;
+    score double_attack_base = 4;
+  } activity_;
 };  // class parameters
 
+inline constexpr parameters::parameters(builtin_t)
+{
+  init();
+}
+
+inline constexpr int parameters::pawn::scale(int y_min, int y_max,
+                                             int x_min, int x_max, int x)
+{
+  assert(y_min <= y_max);
+  assert(x_min < x_max);
+  assert(x_min <= x && x <= x_max);
+
+  const auto dy(y_max - y_min), dx(x_max - x_min);
+  return (dy * (x - x_min) + y_min * dx) / dx;
+}
+
+// Computes the tables used by the evaluation.
+inline constexpr void parameters::init()
+{
+  pawn_.init();
+  pcsq_.init();
+  pp_adj_.init();
+  activity_.init();
+}
+
+inline constexpr void parameters::pawn::init()
+{
+  // not used - just for security
+  passed[0] = protected_passed[0] = packed_score();
+
+  for (int r(1); r < 7; ++r)
+  {
+    const score e(scale(passed_min_e, passed_max_e, 1, 6, r));
+    const score m(scale(passed_min_m, passed_max_m, 1, 6, r));
+
+    passed[r] = packed_score(m, e);
+    protected_passed[r] = packed_score(m, e * protected_passed_perc / 100);
+  }
+
+  doubled = packed_score(doubled_m, doubled_e);
+  assert(passed[6].eg() == passed_max_e);
+  assert(passed[1].eg() == passed_min_e);
+  assert(passed[6].mg() == passed_max_m);
+  assert(passed[1].mg() == passed_min_m);
+  assert(protected_passed[6].eg()
+         == passed_max_e * protected_passed_perc / 100);
+  assert(protected_passed[1].eg()
+         == passed_min_e * protected_passed_perc / 100);
+
+  for (unsigned f(0); f < 8; ++f)
+  {
+    const auto dist(f >= FILE_E ? FILE_H - f : f - FILE_A);
+
+    weak_e[f] = scale(weak_min_e, weak_max_e, 0, 3, dist);
+    weak_m[f] = scale(weak_min_m, weak_max_m, 0, 3, dist);
+
+    weak_open_e[f] = weak_e[f] * weak_open_perc / 100;
+    weak_open_m[f] = weak_m[f] * weak_open_perc / 100;
+  }
+
+  assert(weak_e[FILE_A] == weak_e[FILE_H]);
+  assert(weak_m[FILE_A] == weak_m[FILE_H]);
+  assert(weak_open_e[FILE_A] == weak_open_e[FILE_H]);
+  assert(weak_open_m[FILE_A] == weak_open_m[FILE_H]);
+
+  assert(weak_e[FILE_A] == weak_min_e);
+  assert(weak_m[FILE_A] == weak_min_m);
+  assert(weak_e[FILE_D] == weak_max_e);
+  assert(weak_m[FILE_D] == weak_max_m);
+  assert(weak_open_e[FILE_A] == weak_min_e * weak_open_perc / 100);
+  assert(weak_open_m[FILE_A] == weak_min_m * weak_open_perc / 100);
+  assert(weak_open_e[FILE_D] == weak_max_e * weak_open_perc / 100);
+  assert(weak_open_m[FILE_D] == weak_max_m * weak_open_perc / 100);
+}
+
+// The general idea comes from Fruit.
+inline constexpr void parameters::pcsq::init()
+{
+  // The non-const `std::array::operator[]` isn't `constexpr` in C++14.
+  const pcsq &base(*this);
+
+  // Tables are built incrementally: start from scratch (`init` may be called
+  // more than once and the object isn't necessarily statically allocated).
+  for (unsigned p(0); p < piece::sup_id; ++p)
+    for (square i(0); i < 64; ++i)
+      mg[p][i] = eg[p][i] = 0;
+
+  // # PAWNS
+  // ## File
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    mg[WPAWN.id()][i] += base.pawn_file_base[f] * pawn_file_mult_m;
+  }
+
+  // ## Centre control
+  mg[WPAWN.id()][D3] += 10;
+  mg[WPAWN.id()][E3] += 10;
+
+  mg[WPAWN.id()][D4] += 20;
+  mg[WPAWN.id()][E4] += 20;
+
+  mg[WPAWN.id()][D5] += 10;
+  mg[WPAWN.id()][E5] += 10;
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WPAWN.id()][i] *= pawn_weight;
+    mg[WPAWN.id()][i] /=         100;
+
+    eg[WPAWN.id()][i] *= pawn_weight;
+    eg[WPAWN.id()][i] /=         100;
+  }
+
+  // # KNIGHTS
+  // ## Centre
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
+
+    const auto knight_centre(base.knight_centre_base[f]
+                             + base.knight_centre_base[r]);
+
+    mg[WKNIGHT.id()][i] += knight_centre * knight_centre_mult_m;
+    eg[WKNIGHT.id()][i] += knight_centre * knight_centre_mult_e;
+  }
+
+  // ## Rank
+  for (square i(0); i < 64; ++i)
+    mg[WKNIGHT.id()][i] += base.knight_rank_base[rank(i)] * knight_rank_mult_m;
+
+  // ## Back rank
+  for (square i(A1); i <= H1; ++i)
+    mg[WKNIGHT.id()][i] -= knight_backrank_base_m;
+
+  // ## "Trapped"
+  mg[WKNIGHT.id()][A8] -= knight_trapped_base_m;
+  mg[WKNIGHT.id()][H8] -= knight_trapped_base_m;
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WKNIGHT.id()][i] *= piece_weight;
+    mg[WKNIGHT.id()][i] /=          100;
+
+    eg[WKNIGHT.id()][i] *= piece_weight;
+    eg[WKNIGHT.id()][i] /=          100;
+  }
+
+  // # BISHOPS
+  // ## Centre
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
+
+    const auto bishop_centre(base.bishop_centre_base[f]
+                             + base.bishop_centre_base[r]);
+
+    mg[WBISHOP.id()][i] += bishop_centre * bishop_centre_mult_m;
+
+    eg[WBISHOP.id()][i] += bishop_centre * bishop_centre_mult_e;
+  }
+
+  // ## Back rank
+  for (square i(A1); i <= H1; ++i)
+    mg[WBISHOP.id()][i] -= bishop_backrank_base_m;
+
+  // ## Main diagonals
+  mg[WBISHOP.id()][A1] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][B2] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][C3] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][D4] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][E5] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][F6] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][G7] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][H8] += bishop_diagonal_base_m;
+
+  mg[WBISHOP.id()][H1] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][G2] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][F3] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][E4] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][D5] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][C6] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][B7] += bishop_diagonal_base_m;
+  mg[WBISHOP.id()][A8] += bishop_diagonal_base_m;
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WBISHOP.id()][i] *= piece_weight;
+    mg[WBISHOP.id()][i] /=          100;
+
+    eg[WBISHOP.id()][i] *= piece_weight;
+    eg[WBISHOP.id()][i] /=          100;
+  }
+
+  // # ROOKS
+  // ## File
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    mg[WROOK.id()][i] += base.rook_file_base[f] * rook_file_mult_m;
+  }
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WROOK.id()][i] *= piece_weight;
+    mg[WROOK.id()][i] /=          100;
+
+    eg[WROOK.id()][i] *= piece_weight;
+    eg[WROOK.id()][i] /=          100;
+  }
+
+  // # QUEENS
+  // ## Centre
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
+
+    const auto queen_centre(base.queen_centre_base[f]
+                            + base.queen_centre_base[r]);
+
+    mg[WQUEEN.id()][i] += queen_centre * queen_centre_mult_m;
+    eg[WQUEEN.id()][i] += queen_centre * queen_centre_mult_e;
+  }
+
+  // ## Back rank
+  for (square i(A1); i <= H1; ++i)
+    mg[WQUEEN.id()][i] -= queen_backrank_base_m;
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WQUEEN.id()][i] *= piece_weight;
+    mg[WQUEEN.id()][i] /=          100;
+
+    eg[WQUEEN.id()][i] *= piece_weight;
+    eg[WQUEEN.id()][i] /=          100;
+  }
+
+  // # KINGS
+  // ## Centre
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    const auto r(rank(i) < 4 ? rank(i) : 7 - rank(i));
+
+    const auto king_centre(base.king_centre_base[f]
+                           + base.king_centre_base[r]);
+
+    eg[WKING.id()][i] += king_centre * king_centre_mult_e;
+  }
+
+  // ## File
+  for (square i(0); i < 64; ++i)
+  {
+    const auto f(file(i) < 4 ? file(i) : 7 - file(i));
+    mg[WKING.id()][i] += base.king_file_base[f] * king_file_mult_m;
+  }
+
+  // ## Rank
+  for (square i(0); i < 64; ++i)
+    mg[WKING.id()][i] += base.king_rank_base[rank(i)] * king_rank_mult_m;
+
+  // ## Weight
+  for (square i(0); i < 64; ++i)
+  {
+    mg[WKING.id()][i] *= king_weight;
+    mg[WKING.id()][i] /=         100;
+
+    eg[WKING.id()][i] *= piece_weight;
+    eg[WKING.id()][i] /=          100;
+  }
+
+  // Flipped copy for BLACK.
+  for (unsigned t(piece::pawn); t <= piece::queen; ++t)
+    for (square i(0); i < 64; ++i)
+    {
+      const auto pb(piece(BLACK, t).id());
+      const auto pw(piece(WHITE, t).id());
+
+      eg[pb][flip(i)] = eg[pw][i];
+      mg[pb][flip(i)] = mg[pw][i];
+    }
+
+  for (unsigned p(0); p < piece::sup_id; ++p)
+    for (square i(0); i < 64; ++i)
+      packed[p][i] = packed_score(mg[p][i], eg[p][i]);
+}
+
+inline constexpr void parameters::pp_adj::init()
+{
+  n[0] = knight_wo_pawns_base;
+  r[0] =   rook_wo_pawns_base;
+  for (int i(1); i < 9; ++i)
+  {
+    n[i] = n[0] + knight_wo_pawns_d * i;
+    r[i] = n[0] +   rook_wo_pawns_d * i;
+  }
+}
+
+inline constexpr void parameters::activity::init()
+{
+  // Maximum number of attacked squares and average mobility of every piece
+  // type (pieces with average mobility get no bonus).
+  const unsigned max_n[piece::queen + 1] = {0, 0,  8, 13, 14, 27};
+  const int    centre[piece::queen + 1] = {0, 0,  4,  6,  7, 13};
+
+  const int mult_m[piece::queen + 1] =
+  {
+    0, 0, knight_mobility_mult_m, bishop_mobility_mult_m,
+    rook_mobility_mult_m, queen_mobility_mult_m
+  };
+  const int mult_e[piece::queen + 1] =
+  {
+    0, 0, knight_mobility_mult_e, bishop_mobility_mult_e,
+    rook_mobility_mult_e, queen_mobility_mult_e
+  };
+
+  for (unsigned t(piece::knight); t <= piece::queen; ++t)
+    for (unsigned n(0); n < 28; ++n)
+      mobility[t][n] = n <= max_n[t]
+                       ? packed_score((int(n) - centre[t]) * mult_m[t],
+                                      (int(n) - centre[t]) * mult_e[t])
+                       : packed_score();
+
+  king_attack[piece::knight] = knight_attack_base;
+  king_attack[piece::bishop] = bishop_attack_base;
+  king_attack[piece::rook]   =   rook_attack_base;
+  king_attack[piece::queen]  =  queen_attack_base;
+  king_attack2 = double_attack_base;
+}
+
+// Compile-time parameters: the built-in values of `parameters` computed by
+// the compiler. Used as a policy by the evaluation, which is specialised on
+// the source of its parameters: with `baked_parameters` every table lookup
+// reads a constant object and can be folded.
+class baked_parameters
+{
+public:
+  static constexpr parameters values = parameters(parameters::builtin);
+};
+
 extern parameters db;
 
+// The set of values behind a parameter source.
+inline const parameters &values(const parameters &p) noexcept { return p; }
+inline constexpr const parameters &values(baked_parameters) noexcept
+{ return baked_parameters::values; }
+
+// Parameters used by the engine: the built-in tables when the
+// `TESTUDO_CONSTEXPR_PARAMETERS` macro is defined (`testudo.json` isn't
+// read), `db` otherwise (the runtime loadable mode required for tuning).
+#if defined(TESTUDO_CONSTEXPR_PARAMETERS)
+inline constexpr baked_parameters engine_parameters() noexcept { return {}; }
+#else
+inline const parameters &engine_parameters() noexcept { return db; }
+#endif
+
 }  // namespace testudo
 
 #endif  // include guard
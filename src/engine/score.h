@@ -12,6 +12,7 @@
 #define      TESTUDO_SCORE_H
 
 #include <cmath>
+#include <cstdint>
 
 namespace testudo
 {
@@ -27,6 +28,66 @@ constexpr score MATE(31000);
 
 inline bool is_mate(score s) { return std::abs(s) >= MATE; }
 
+// A mid-game and an end-game score packed in a single integer: the end-game
+// score is in the upper 16 bits, the mid-game score in the lower 16 bits.
+// Sums and differences of packed scores are the packed sums and differences
+// (the borrow from a negative mid-game score is taken back by `eg()`), so a
+// tapered evaluation term is accumulated with a single operation and the two
+// values are split only at the end.
+class packed_score
+{
+public:
+  constexpr packed_score() noexcept : v_(0) {}
+  constexpr packed_score(score mg, score eg) noexcept
+    : v_(static_cast<std::int32_t>(static_cast<std::uint32_t>(eg) << 16) + mg)
+  {
+  }
+
+  constexpr score mg() const noexcept
+  {
+    return static_cast<std::int16_t>(static_cast<std::uint16_t>(v_));
+  }
+  constexpr score eg() const noexcept
+  {
+    return static_cast<std::int16_t>(
+      static_cast<std::uint16_t>((static_cast<std::uint32_t>(v_) + 0x8000)
+                                 >> 16));
+  }
+
+  // Interpolates between the mid-game and end-game scores (`phase` goes from
+  // 0, opening, to 256, endgame).
+  constexpr score taper(int phase) const noexcept
+  {
+    return (mg() * (256 - phase) + eg() * phase) / 256;
+  }
+
+  constexpr packed_score &operator+=(packed_score rhs) noexcept
+  { v_ += rhs.v_;  return *this; }
+  constexpr packed_score &operator-=(packed_score rhs) noexcept
+  { v_ -= rhs.v_;  return *this; }
+
+  friend constexpr packed_score operator+(packed_score lhs,
+                                          packed_score rhs) noexcept
+  { return lhs += rhs; }
+  friend constexpr packed_score operator-(packed_score lhs,
+                                          packed_score rhs) noexcept
+  { return lhs -= rhs; }
+  friend constexpr packed_score operator-(packed_score s) noexcept
+  { return packed_score() - s; }
+  friend constexpr packed_score operator*(packed_score s, int n) noexcept
+  { s.v_ *= n;  return s; }
+
+  friend constexpr bool operator==(packed_score lhs,
+                                   packed_score rhs) noexcept
+  { return lhs.v_ == rhs.v_; }
+  friend constexpr bool operator!=(packed_score lhs,
+                                   packed_score rhs) noexcept
+  { return !(lhs == rhs); }
+
+private:
+  std::int32_t v_;
+};
+
 }  // namespace testudo
 
 #endif  // include guard
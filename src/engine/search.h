@@ -15,6 +15,8 @@
 #include <chrono>
 #include <functional>
 
+#include "cache.h"
+#include "eval_cache.h"
 #include "state.h"
 
 namespace testudo
@@ -31,7 +33,8 @@ public:
   struct statistics
   {
     statistics() : moves_at_root(), snodes(0), qnodes(0), depth(0),
-                   score_at_root(0) {}
+                   score_at_root(0), fail_low(0), fail_high(0),
+                   research_nodes(0), tbhits(0), tt(), hashfull(0), ec() {}
     void reset() { *this = statistics(); }
 
     movelist       moves_at_root;
@@ -39,6 +42,22 @@ public:
     std::uintmax_t        qnodes;  // quiescence search nodes
     unsigned               depth;  // depth reached
     score          score_at_root;
+
+    // Aspiration windows: number of searches failing low / high (each one
+    // requires a re-search) and nodes spent in those failed searches.
+    unsigned            fail_low;
+    unsigned           fail_high;
+    std::uintmax_t research_nodes;
+
+    std::uintmax_t tbhits;  // positions found in the endgame tablebases
+
+    // Transposition table counters (see `cache::statistics`) and per-mille
+    // of the table used by the search.
+    cache::statistics tt;
+    unsigned    hashfull;
+
+    // Evaluation cache counters (see `eval_cache::statistics`).
+    eval_cache::statistics ec;
   } stats;
 
   struct constraints
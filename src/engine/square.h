@@ -11,6 +11,7 @@
 #if !defined(TESTUDO_SQUARE_H)
 #define      TESTUDO_SQUARE_H
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 
@@ -68,6 +69,20 @@ inline constexpr square flip(square sq)
   return sq ^ 56;
 }
 
+// Number of king moves needed to go from one square to another (Chebyshev
+// distance).
+inline unsigned distance(square s1, square s2) noexcept
+{
+  assert(0 <= s1 && s1 < 64);
+  assert(0 <= s2 && s2 < 64);
+
+  const int df(int(file(s1)) - int(file(s2)));
+  const int dr(int(rank(s1)) - int(rank(s2)));
+
+  return static_cast<unsigned>(std::max(df < 0 ? -df : df,
+                                        dr < 0 ? -dr : dr));
+}
+
 // Forward moving offset for a Pawn of a specific color.
 inline constexpr int step_fwd(color c) noexcept
 { return c == BLACK ? 8 : -8; }
@@ -13,6 +13,7 @@
 #include <sstream>
 
 #include "state.h"
+#include "parameters.h"
 #include "zobrist.h"
 
 namespace testudo
@@ -112,10 +113,15 @@ std::ostream &operator<<(std::ostream &o, const state &s)
 }
 
 state::state(setup t) noexcept
-  : stm_(WHITE), castle_(0), ep_(-1), fifty_(0), hash_(0), piece_cnt_{}
+  : color_bb_(), type_bb_(), stm_(WHITE), castle_(0), ep_(-1), fifty_(0),
+    hash_(0), material_key_(0), pcsq_(), piece_cnt_{}
 {
   std::fill(board_.begin(), board_.end(), EMPTY);
 
+#if defined(TESTUDO_NNUE)
+  nnue::net.reset(acc_);
+#endif
+
   if (t == setup::start)
   {
     static const std::array<piece, 64> init_piece(
@@ -154,7 +160,6 @@ state state::color_flip() const
   for (square i(0); i < 64; ++i)
     if (board_[i] != EMPTY)
       ret.fill_square(piece(!board_[i].color(), board_[i].type()), flip(i));
-  ret.hash_ = zobrist::hash(*this);
 
   ret.stm_ = !side();
 
@@ -168,11 +173,13 @@ state state::color_flip() const
   if (castle() & black_queenside)
     ret.castle_ |= white_queenside;
 
-  if (en_passant())
+  if (en_passant() != -1)
     ret.ep_ = en_passant() ^ 56;
 
   ret.fifty_ = fifty_;
 
+  ret.hash_ = zobrist::hash(ret);
+
   return ret;
 }
 
@@ -516,7 +523,7 @@ bool state::attack(square target, color attacker) const
 }
 
 // Erases a piece on a given square and takes care for all the incrementally
-// updated stuff: hash keys, piece counters...
+// updated stuff: hash keys, piece counters, piece/square values...
 void state::clear_square(square i)
 {
   assert(valid(i));
@@ -524,15 +531,26 @@ void state::clear_square(square i)
   assert(p != EMPTY);
 
   hash_ ^= zobrist::piece[p.id()][i];
+  pcsq_[p.color()] -= values(engine_parameters()).pcsq(p, i);
+#if defined(TESTUDO_NNUE)
+  if (acc_.id)
+    nnue::net.sub(acc_, p, i);
+#endif
   board_[i] = EMPTY;
+  color_bb_[p.color()] ^= bb(i);
+  type_bb_[p.type()] ^= bb(i);
 
   assert(p.type() == piece::king || piece_cnt_[p.color()][p.type()]);
   if (p.type() != piece::king)
+  {
     --piece_cnt_[p.color()][p.type()];
+    material_key_ ^= zobrist::piece[p.id()][piece_cnt_[p.color()][p.type()]];
+  }
 }
 
 // Place a piece on a given square and takes care for all the incrementally
-// updated stuff: hash keys, piece counters, king location...
+// updated stuff: hash keys, piece counters, piece/square values, king
+// location...
 void state::fill_square(piece p, square i)
 {
   assert(p != EMPTY);
@@ -540,18 +558,37 @@ void state::fill_square(piece p, square i)
   assert(board_[i] == EMPTY);
 
   hash_ ^= zobrist::piece[p.id()][i];
+  pcsq_[p.color()] += values(engine_parameters()).pcsq(p, i);
+#if defined(TESTUDO_NNUE)
+  if (acc_.id)
+    nnue::net.add(acc_, p, i);
+#endif
   board_[i] = p;
+  color_bb_[p.color()] |= bb(i);
+  type_bb_[p.type()] |= bb(i);
 
   if (p.type() == piece::king)
     piece_cnt_[p.color()][piece::king] = i;
   else
+  {
+    // The i-th piece of a given type is keyed as if it were on square `i`.
+    material_key_ ^= zobrist::piece[p.id()][piece_cnt_[p.color()][p.type()]];
     ++piece_cnt_[p.color()][p.type()];
+  }
 }
 
 bool state::make_move(const move &m)
 {
   assert (m);
 
+#if defined(TESTUDO_NNUE)
+  // The accumulator of a state created before loading the current network
+  // weights is outdated: it's recomputed once, then children inherit an up to
+  // date accumulator.
+  if (acc_.id != nnue::net.id())
+    nnue::net.refresh(*this, acc_);
+#endif
+
   const color xside(!side());
 
   // Test to see if a castle move is legal and move the Rook (the King is
@@ -649,6 +686,54 @@ bool state::make_move(const move &m)
   return !in_check(!side());
 }
 
+// Computes the hash key of the position reached after `m` using the Zobrist
+// deltas of the move (it's the same sequence of updates performed by
+// `make_move` but doesn't touch the board).
+// The move must be pseudo-legal.
+hash_t state::key_after(const move &m) const noexcept
+{
+  assert(m);
+
+  const piece p(board_[m.from]);
+  assert(p.color() == side());
+
+  hash_t h(hash_ ^ zobrist::side);
+
+  if (m.flags & move::castle)
+  {
+    const auto rook(piece(side(), piece::rook).id());
+    switch (m.to)
+    {
+    case G1:  h ^= zobrist::piece[rook][H1] ^ zobrist::piece[rook][F1];  break;
+    case C1:  h ^= zobrist::piece[rook][A1] ^ zobrist::piece[rook][D1];  break;
+    case G8:  h ^= zobrist::piece[rook][H8] ^ zobrist::piece[rook][F8];  break;
+    default:  h ^= zobrist::piece[rook][A8] ^ zobrist::piece[rook][D8];  break;
+    }
+  }
+
+  if (castle())
+    h ^= zobrist::castle[castle()];
+  const auto c(castle() & castle_mask[m.from] & castle_mask[m.to]);
+  if (c)
+    h ^= zobrist::castle[c];
+
+  if (valid(en_passant()))
+    h ^= zobrist::ep[file(en_passant())];
+  if (m.flags & move::two_squares)
+    h ^= zobrist::ep[file(m.to)];
+
+  if (m.flags & move::en_passant)
+    h ^= zobrist::piece[piece(!side(), piece::pawn).id()]
+                       [m.to - step_fwd(side())];
+  else if (board_[m.to] != EMPTY)
+    h ^= zobrist::piece[board_[m.to].id()][m.to];
+
+  const piece moved(is_promotion(m) ? piece(side(), m.promote()) : p);
+  h ^= zobrist::piece[p.id()][m.from] ^ zobrist::piece[moved.id()][m.to];
+
+  return h;
+}
+
 state::kind state::mate_or_draw(const std::vector<hash_t> *history) const
 {
   if (moves().empty())
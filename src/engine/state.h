@@ -11,10 +11,15 @@
 #if !defined(TESTUDO_STATE_H)
 #define      TESTUDO_STATE_H
 
+#include "bitboard.h"
 #include "move.h"
 #include "movelist.h"
 #include "zobrist.h"
 
+#if defined(TESTUDO_NNUE)
+#  include "nnue.h"
+#endif
+
 namespace testudo
 {
 
@@ -58,6 +63,11 @@ public:
 
   piece operator[](square s) const noexcept { return board_[s]; }
 
+  // Sets of the pieces of a given color (and type).
+  bitboard pieces(color c) const noexcept { return color_bb_[c]; }
+  bitboard pieces(color c, enum piece::type t) const noexcept
+  { return color_bb_[c] & type_bb_[t]; }
+
   // Fifty moves draw counter value.
   auto fifty() const noexcept { return fifty_; }
   // En passant square.
@@ -79,6 +89,18 @@ public:
   move parse_move(const std::string &) const;
 
   hash_t hash() const noexcept { return hash_; }
+  hash_t material_key() const noexcept { return material_key_; }
+
+  // Sum of the piece/square values of the pieces of a given color (see
+  // `parameters::pcsq`).
+  packed_score pcsq(color c) const noexcept { return pcsq_[c]; }
+
+#if defined(TESTUDO_NNUE)
+  // First layer of the neural network evaluator (see `nnue::network`).
+  const nnue::accumulator &accumulator() const noexcept { return acc_; }
+#endif
+  // Hash key of the state after the given move (the move isn't made).
+  hash_t key_after(const move &) const noexcept;
 
   unsigned piece_count(color, enum piece::type) const;
   square king_square(color) const;
@@ -97,6 +119,11 @@ private:
   friend bool operator==(const state &, const state &);
 
   std::array<piece, 64> board_; // piece+color or EMPTY
+
+  // The same information of `board_` as sets of squares (see `pieces`).
+  bitboard color_bb_[2];
+  bitboard type_bb_[6];
+
   color stm_;                   // side to move
   std::uint8_t castle_;         // castle permissions
   square ep_;                   // en passant square
@@ -104,6 +131,16 @@ private:
 
   hash_t hash_;
 
+  // Depends only on the number of pieces of each type (kings excluded) and
+  // identifies the material configuration (see `material_table`).
+  hash_t material_key_;
+
+  packed_score pcsq_[2];
+
+#if defined(TESTUDO_NNUE)
+  nnue::accumulator acc_;
+#endif
+
   // Piece counter. E.g `piece_cnt[WHITE][piece::knight]` contains the number
   // of white knights on the board.
   // `piece_cnt[WHITE][piece::king]` is special: since there are always two
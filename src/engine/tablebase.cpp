@@ -0,0 +1,1103 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "tablebase.h"
+#include "attacks.h"
+#include "nonstd.h"
+#include "util.h"
+#include "zobrist.h"
+
+namespace testudo
+{
+
+namespace tablebase
+{
+
+namespace
+{
+
+// Content of a table entry: `dtm + 1` for decided positions, where `dtm` is
+// the number of plies to mate (even: the side to move is mated; odd: the
+// side to move mates).
+constexpr std::uint8_t DRAW = 0;
+constexpr std::uint8_t UNKNOWN = 254;  // not yet decided (generation only)
+constexpr std::uint8_t INVALID = 255;  // illegal / non canonical positions
+
+constexpr unsigned LEVELS = UNKNOWN - 1;  // allowed `dtm` values
+
+// Pieces from the strongest. Table names list pieces in this order.
+const std::string ORDER("QRBNP");
+
+enum piece::type type(char letter)
+{
+  switch (letter)
+  {
+  case 'Q':  return piece::queen;
+  case 'R':  return piece::rook;
+  case 'B':  return piece::bishop;
+  case 'N':  return piece::knight;
+  default:   assert(letter == 'P');  return piece::pawn;
+  }
+}
+
+// A position with a few pieces. Every board square of a table is decoded in
+// such a structure: it's much faster than `state` for the retrograde
+// analysis.
+struct position
+{
+  bitboard occupied() const
+  {
+    bitboard ret(0);
+    for (unsigned i(0); i < n; ++i)
+      ret |= bb(sq[i]);
+    return ret;
+  }
+
+  bitboard pieces(color c) const
+  {
+    bitboard ret(0);
+    for (unsigned i(0); i < n; ++i)
+      if (pc[i].color() == c)
+        ret |= bb(sq[i]);
+    return ret;
+  }
+
+  square king(color c) const
+  {
+    unsigned i(0);
+    while (pc[i] != piece(c, piece::king))
+      ++i;
+
+    assert(i < n);
+    return sq[i];
+  }
+
+  unsigned n = 0;
+  piece pc[MAX_PIECES];
+  square sq[MAX_PIECES] = {};  // unused elements are kept valid
+  color stm = WHITE;
+};
+
+bool attacked(const position &p, square target, color by)
+{
+  const bitboard occ(p.occupied());
+
+  for (unsigned i(0); i < p.n; ++i)
+    if (p.pc[i].color() == by)
+    {
+      const auto t(p.pc[i].type());
+      const bitboard a(t == piece::pawn ? pawn_attacks(by, bb(p.sq[i]))
+                                        : attacks(t, p.sq[i], occ));
+      if (a & bb(target))
+        return true;
+    }
+
+  return false;
+}
+
+bool in_check(const position &p)
+{
+  return attacked(p, p.king(p.stm), !p.stm);
+}
+
+bool legal(const position &p)
+{
+  if (popcount(p.occupied()) != p.n)
+    return false;
+
+  return distance(p.king(WHITE), p.king(BLACK)) > 1
+         && !attacked(p, p.king(!p.stm), p.stm);
+}
+
+// Material key (see `zobrist::material_hash`) of a position.
+hash_t material_key(const position &p)
+{
+  unsigned count[piece::sup_id] = {};
+  hash_t ret(0);
+
+  for (unsigned i(0); i < p.n; ++i)
+    if (p.pc[i].type() != piece::king)
+    {
+      const auto id(p.pc[i].id());
+      ret ^= zobrist::piece[id][count[id]++];
+    }
+
+  return ret;
+}
+
+int forward(color c)
+{
+  return c == WHITE ? -8 : 8;
+}
+
+// Calls `f(q, exit)` for every legal move leading from `p` to `q`. `exit` is
+// `true` for captures and promotions (`q` belongs to another table).
+// Pieces of `q` keep the order they have in `p`.
+template<class F>
+void for_each_move(const position &p, F f)
+{
+  const bitboard occ(p.occupied()), own(p.pieces(p.stm));
+
+  const auto add(
+    [&](unsigned i, square to, piece promoted)
+    {
+      position q(p);
+      bool exit(false);
+
+      for (unsigned j(0); j < q.n; ++j)
+        if (q.sq[j] == to)  // capture
+        {
+          std::copy(q.pc + j + 1, q.pc + q.n, q.pc + j);
+          std::copy(q.sq + j + 1, q.sq + q.n, q.sq + j);
+          --q.n;
+
+          if (j < i)
+            --i;
+          exit = true;
+          break;
+        }
+
+      q.sq[i] = to;
+      if (q.pc[i] != promoted)
+      {
+        q.pc[i] = promoted;
+        exit = true;
+      }
+      q.stm = !p.stm;
+
+      if (!attacked(q, q.king(p.stm), q.stm))
+        f(q, exit);
+    });
+
+  for (unsigned i(0); i < p.n; ++i)
+  {
+    if (p.pc[i].color() != p.stm)
+      continue;
+
+    const auto t(p.pc[i].type());
+    const square from(p.sq[i]);
+
+    if (t != piece::pawn)
+    {
+      for (bitboard b(attacks(t, from, occ) & ~own); b; b &= b - 1)
+        add(i, lsb(b), p.pc[i]);
+      continue;
+    }
+
+    bitboard b(pawn_attacks(p.stm, bb(from)) & occ & ~own);
+
+    const square push(from + forward(p.stm));
+    if (!(occ & bb(push)))
+    {
+      b |= bb(push);
+
+      const square push2(push + forward(p.stm));
+      if (rank(from) == second_rank(p.stm) && !(occ & bb(push2)))
+        b |= bb(push2);
+    }
+
+    for (; b; b &= b - 1)
+    {
+      const square to(lsb(b));
+
+      if (rank(to) == eighth_rank(p.stm))
+        for (auto promotion : {piece::queen, piece::rook, piece::bishop,
+                               piece::knight})
+          add(i, to, piece(p.stm, promotion));
+      else
+        add(i, to, p.pc[i]);
+    }
+  }
+}
+
+// Calls `f(q)` for every position `q` with the same material of `p` from
+// which a (non capture) move leads to `p`. `q` can be illegal.
+template<class F>
+void for_each_unmove(const position &p, F f)
+{
+  const color mover(!p.stm);
+  const bitboard occ(p.occupied());
+
+  for (unsigned i(0); i < p.n; ++i)
+  {
+    if (p.pc[i].color() != mover)
+      continue;
+
+    const auto t(p.pc[i].type());
+    bitboard b(0);
+
+    if (t != piece::pawn)
+      b = attacks(t, p.sq[i], occ) & ~occ;
+    else if (rank(p.sq[i]) != second_rank(mover))
+    {
+      const square from(p.sq[i] - forward(mover));
+      if (!(occ & bb(from)))
+      {
+        b = bb(from);
+
+        const square from2(from - forward(mover));
+        if (rank(from2) == second_rank(mover) && !(occ & bb(from2)))
+          b |= bb(from2);
+      }
+    }
+
+    for (; b; b &= b - 1)
+    {
+      position q(p);
+      q.sq[i] = lsb(b);
+      q.stm = mover;
+      f(q);
+    }
+  }
+}
+
+// The eight symmetries of the board and the a1-d1-d4 triangle (ten squares)
+// used to place the strong king of pawnless tables.
+struct symmetry_tables
+{
+  symmetry_tables();
+
+  square transform[8][64];
+  int triangle[64];     // index of a square inside the triangle (or -1)
+  square corner[10];    // square of a triangle index
+};
+
+symmetry_tables::symmetry_tables() : transform(), triangle(), corner()
+{
+  for (square sq(0); sq < 64; ++sq)
+  {
+    for (unsigned t(0); t < 8; ++t)
+    {
+      unsigned f(file(sq)), r(rank(sq));
+
+      if (t & 1)
+        f = 7 - f;
+      if (t & 2)
+        r = 7 - r;
+      if (t & 4)
+        std::swap(f, r);
+
+      transform[t][sq] = to_square(f, r);
+    }
+
+    triangle[sq] = -1;
+  }
+
+  int i(0);
+  for (unsigned f(0); f <= FILE_D; ++f)
+    for (unsigned r(0); r <= f; ++r)
+    {
+      corner[i] = to_square(f, r);
+      triangle[corner[i]] = i;
+      ++i;
+    }
+}
+
+const symmetry_tables symmetry;
+
+// Pieces are stored in a fixed order: strong king, weak king, strong pieces,
+// weak pieces. The strong side is always WHITE (positions with a black
+// strong side are color-flipped).
+class table
+{
+public:
+  explicit table(const std::string &);
+
+  const std::string &name() const noexcept { return name_; }
+  unsigned pieces() const noexcept { return n_; }
+  piece at(unsigned i) const noexcept { return pc_[i]; }
+
+  // Number of entries (positions with WHITE to move followed by positions
+  // with BLACK to move).
+  std::size_t entries() const noexcept { return 2 * size_; }
+
+  std::size_t entry(const position &p) const
+  {
+    return (p.stm == WHITE ? 0 : size_) + index(p);
+  }
+  position decode(std::size_t) const;
+
+  hash_t key(color) const;
+
+  std::uint8_t operator[](std::size_t i) const { return data_[i]; }
+  void data(large_memory, std::size_t);
+
+private:
+  template<class T> std::size_t raw_index(const position &, T) const;
+  std::size_t index(const position &) const;
+
+  std::string name_;
+  unsigned n_;
+  piece pc_[MAX_PIECES];
+  bool pawns_;
+  std::size_t size_;  // positions for one side to move
+
+  large_memory memory_;
+  const std::uint8_t *data_;
+};
+
+table::table(const std::string &name)
+  : name_(name), n_(2), pc_(), pawns_(false), size_(0), data_(nullptr)
+{
+  const auto weak_king(name.find('K', 1));
+  assert(name.front() == 'K' && weak_king != std::string::npos);
+
+  pc_[0] = WKING;
+  pc_[1] = BKING;
+
+  for (std::size_t i(1); i < name.size(); ++i)
+    if (i != weak_king)
+    {
+      assert(n_ < MAX_PIECES);
+      pc_[n_++] = piece(i < weak_king ? WHITE : BLACK, type(name[i]));
+
+      if (name[i] == 'P')
+        pawns_ = true;
+    }
+
+  size_ = (pawns_ ? 32 : 10) * 64;
+  for (unsigned i(2); i < n_; ++i)
+    size_ *= pc_[i].type() == piece::pawn ? 48 : 64;
+}
+
+// Index of `p` (pieces in table order) after the `tr` transformation of the
+// board.
+template<class T>
+std::size_t table::raw_index(const position &p, T tr) const
+{
+  square sq[MAX_PIECES];
+  std::transform(p.sq, p.sq + MAX_PIECES, sq, tr);
+
+  // Identical pieces are interchangeable (with at most two pieces besides
+  // the kings they can only be the last two ones).
+  if (n_ == 4 && pc_[2] == pc_[3] && sq[2] > sq[3])
+    std::swap(sq[2], sq[3]);
+
+  std::size_t ret(pawns_ ? (sq[0] >> 3) * 4 + file(sq[0])
+                         : symmetry.triangle[sq[0]]);
+  ret = ret * 64 + sq[1];
+
+  for (unsigned i(2); i < n_; ++i)
+    ret = pc_[i].type() == piece::pawn ? ret * 48 + (sq[i] - 8)
+                                       : ret * 64 + sq[i];
+
+  return ret;
+}
+
+// Among the symmetric positions (pawnless tables: eight symmetries; tables
+// with pawns: horizontal mirroring) the one with the smallest index is used.
+std::size_t table::index(const position &p) const
+{
+  if (pawns_)
+  {
+    const int mirror(file(p.sq[0]) > FILE_D ? 7 : 0);
+    return raw_index(p, [mirror](square sq) { return sq ^ mirror; });
+  }
+
+  std::size_t ret(size_);
+  for (unsigned t(0); t < 8; ++t)
+    if (symmetry.triangle[symmetry.transform[t][p.sq[0]]] >= 0)
+      ret = std::min(ret,
+                     raw_index(p, [t](square sq)
+                                  {
+                                    return symmetry.transform[t][sq];
+                                  }));
+
+  return ret;
+}
+
+// The position of a given entry. It could be illegal or non canonical (i.e.
+// `entry(decode(i)) != i`).
+position table::decode(std::size_t i) const
+{
+  position p;
+  p.n = n_;
+  std::copy(pc_, pc_ + n_, p.pc);
+
+  p.stm = i < size_ ? WHITE : BLACK;
+  i %= size_;
+
+  for (unsigned j(n_ - 1); j >= 2; --j)
+  {
+    const unsigned squares(pc_[j].type() == piece::pawn ? 48 : 64);
+    p.sq[j] = static_cast<square>(i % squares + (squares == 48 ? 8 : 0));
+    i /= squares;
+  }
+
+  p.sq[1] = static_cast<square>(i % 64);
+  i /= 64;
+
+  p.sq[0] = pawns_ ? static_cast<square>((i / 4) * 8 + i % 4)
+                   : symmetry.corner[i];
+
+  return p;
+}
+
+// Material key of the table when the strong side is `strong`.
+hash_t table::key(color strong) const
+{
+  position p;
+  p.n = n_;
+
+  for (unsigned i(0); i < n_; ++i)
+    p.pc[i] = piece(pc_[i].color() == WHITE ? strong : !strong,
+                    pc_[i].type());
+
+  return material_key(p);
+}
+
+void table::data(large_memory m, std::size_t offset)
+{
+  memory_ = std::move(m);
+  data_ = static_cast<const std::uint8_t *>(memory_.get()) + offset;
+}
+
+// Tables available for probing.
+class registry
+{
+public:
+  struct element
+  {
+    const table *t;
+    color strong;
+  };
+
+  void add(std::unique_ptr<table>);
+  void clear();
+
+  const element *find(hash_t key) const
+  {
+    const auto it(map_.find(key));
+    return it == map_.end() ? nullptr : &it->second;
+  }
+  const table *find(const std::string &) const;
+
+  bool empty() const noexcept { return map_.empty(); }
+
+private:
+  std::vector<std::unique_ptr<table>> tables_;
+  std::unordered_map<hash_t, element> map_;
+};
+
+// Tables with equal material for both sides (e.g. "KQKQ") are registered
+// with just one strong side.
+void registry::add(std::unique_ptr<table> t)
+{
+  for (color c : {BLACK, WHITE})
+    map_[t->key(c)] = {t.get(), c};
+
+  const auto same([&t](const std::unique_ptr<table> &x)
+                  {
+                    return x->name() == t->name();
+                  });
+  tables_.erase(std::remove_if(tables_.begin(), tables_.end(), same),
+                tables_.end());
+
+  tables_.push_back(std::move(t));
+}
+
+void registry::clear()
+{
+  map_.clear();
+  tables_.clear();
+}
+
+const table *registry::find(const std::string &name) const
+{
+  for (const auto &t : tables_)
+    if (t->name() == name)
+      return t.get();
+
+  return nullptr;
+}
+
+registry tables;
+
+// Value of the entry (see `DRAW`, `INVALID`...) of a position with any
+// material and pieces in any order. `INVALID` if the table isn't available.
+std::uint8_t value(const position &p, hash_t key)
+{
+  if (p.n == 2)
+    return DRAW;
+
+  const auto *r(tables.find(key));
+  if (!r)
+    return INVALID;
+
+  const table &t(*r->t);
+  assert(t.pieces() == p.n);
+
+  position q;
+  q.n = p.n;
+  q.stm = p.stm == r->strong ? WHITE : BLACK;
+
+  bool used[MAX_PIECES] = {};
+  for (unsigned j(0); j < q.n; ++j)
+  {
+    q.pc[j] = t.at(j);
+
+    const piece wanted(q.pc[j].color() == WHITE ? r->strong : !r->strong,
+                       q.pc[j].type());
+    unsigned i(0);
+    while (used[i] || p.pc[i] != wanted)
+      ++i;
+
+    used[i] = true;
+    q.sq[j] = r->strong == WHITE ? p.sq[i] : flip(p.sq[i]);
+  }
+
+  return t[t.entry(q)];
+}
+
+// Sorts the pieces of one side (strongest first).
+std::string sorted(std::string side)
+{
+  std::sort(side.begin(), side.end(),
+            [](char a, char b) { return ORDER.find(a) < ORDER.find(b); });
+  return side;
+}
+
+// Name of the table for the given pieces (kings excluded) of two sides.
+std::string canonical(std::string s1, std::string s2)
+{
+  s1 = sorted(s1);
+  s2 = sorted(s2);
+
+  const auto ranks([](const std::string &side)
+                   {
+                     std::string ret;
+                     for (char c : side)
+                       ret.push_back(char('0' + ORDER.find(c)));
+                     return ret;
+                   });
+
+  if (s2.size() > s1.size()
+      || (s2.size() == s1.size() && ranks(s2) < ranks(s1)))
+    std::swap(s1, s2);
+
+  return "K" + s1 + "K" + s2;
+}
+
+// Tables reached by a capture or a promotion.
+std::vector<std::string> dependencies(const std::string &name)
+{
+  const auto weak_king(name.find('K', 1));
+  const std::string sides[2] = {name.substr(1, weak_king - 1),
+                                name.substr(weak_king + 1)};
+
+  std::vector<std::string> ret;
+  for (unsigned s(0); s < 2; ++s)
+    for (std::size_t i(0); i < sides[s].size(); ++i)
+    {
+      std::string side(sides[s]);
+      const char p(side[i]);
+
+      side.erase(i, 1);
+      if (side.size() + sides[!s].size())
+        ret.push_back(canonical(side, sides[!s]));
+
+      if (p == 'P')
+        for (char promotion : ORDER.substr(0, 4))
+          ret.push_back(canonical(side + promotion, sides[!s]));
+    }
+
+  return ret;
+}
+
+using levels = std::vector<std::vector<std::uint32_t>>;  // entries by `dtm`
+
+// Splits `[0, n)` among `threads` threads calling `f(first, last, found)`.
+// The `found` entries of every thread are then merged into `*out`.
+template<class F>
+void parallel(unsigned threads, std::size_t n, levels *out, F f)
+{
+  std::vector<levels> found(thread_count(n, threads, 0), levels(LEVELS));
+
+  parallel_for(n, threads, 0,
+               [&](unsigned t, std::size_t first, std::size_t last)
+               {
+                 f(first, last, found[t]);
+               });
+
+  for (const auto &l : found)
+    for (unsigned d(0); d < LEVELS; ++d)
+      (*out)[d].insert((*out)[d].end(), l[d].begin(), l[d].end());
+}
+
+// Retrograde analysis.
+// Positions are decided level by level (a level is the set of positions with
+// the same distance to mate `d`):
+// - mates, stalemates and positions whose moves all leave the table
+//   (captures / promotions) are decided looking at the successors;
+// - the predecessors (see `for_each_unmove`) of a position lost in `d` plies
+//   are won in `d + 1`;
+// - the predecessors of a position won in `d` plies are lost if every move
+//   leads to a position won by the opponent (`dtm` is one more than the
+//   longest of these wins).
+// Positions never decided are draws.
+// Entries change (atomically) only from `UNKNOWN` to a final value, so the
+// threads processing the same level can share the table.
+class generator
+{
+public:
+  generator(const table &t, unsigned threads)
+    : t_(t), threads_(threads), v_(new std::atomic<std::uint8_t>[t.entries()]),
+      level_(LEVELS), overflow_(false)
+  {
+  }
+
+  large_memory run();
+
+  // `true` if a mate is too long to be stored (the table is unusable).
+  bool overflow() const noexcept { return overflow_; }
+
+private:
+  // Flags the entries of a level that are won by a capture / promotion but
+  // could have a shorter in-table win.
+  static constexpr std::uint32_t PENDING = 1u << 31;
+
+  std::uint8_t get(std::size_t i) const
+  {
+    return v_[i].load(std::memory_order_relaxed);
+  }
+
+  // Stores the distance to mate of an undecided entry. A `dtm` beyond the
+  // last level (the value would clash with `UNKNOWN`) isn't stored and makes
+  // the generation fail: no table with up to `MAX_PIECES` pieces gets near
+  // this limit.
+  bool resolve(std::size_t i, unsigned dtm)
+  {
+    if (dtm >= LEVELS)
+    {
+      overflow_ = true;
+      return false;
+    }
+
+    std::uint8_t expected(UNKNOWN);
+    return v_[i].compare_exchange_strong(expected, dtm + 1,
+                                         std::memory_order_relaxed);
+  }
+
+  std::uint8_t after(const position &q, bool exit) const
+  {
+    return exit ? value(q, material_key(q)) : get(t_.entry(q));
+  }
+
+  void initial(std::uint32_t, levels &);
+  void retrograde(std::uint32_t, unsigned, levels &);
+
+  const table &t_;
+  const unsigned threads_;
+  std::unique_ptr<std::atomic<std::uint8_t>[]> v_;
+  levels level_;
+  std::atomic<bool> overflow_;
+};
+
+void generator::initial(std::uint32_t i, levels &found)
+{
+  const position p(t_.decode(i));
+
+  if (t_.entry(p) != i || !legal(p))
+  {
+    v_[i].store(INVALID, std::memory_order_relaxed);
+    return;
+  }
+
+  unsigned moves(0), win(LEVELS), loss(0);
+  bool draw(false), inside(false);
+
+  for_each_move(p, [&](const position &q, bool exit)
+                   {
+                     ++moves;
+
+                     if (!exit)
+                       inside = true;
+                     else
+                     {
+                       const unsigned x(after(q, exit));
+                       assert(x != INVALID);
+
+                       if (x == DRAW)
+                         draw = true;
+                       else if ((x - 1) % 2 == 0)  // the opponent is mated
+                         win = std::min(win, x);
+                       else
+                         loss = std::max(loss, x);
+                     }
+                   });
+
+  v_[i].store(UNKNOWN, std::memory_order_relaxed);
+
+  if (!moves)
+  {
+    if (in_check(p))
+    {
+      resolve(i, 0);
+      found[0].push_back(i);
+    }
+    else
+      v_[i].store(DRAW, std::memory_order_relaxed);
+  }
+  else if (inside)
+  {
+    if (win < LEVELS)
+      found[win].push_back(i | PENDING);
+  }
+  else if (win < LEVELS)
+  {
+    resolve(i, win);
+    found[win].push_back(i);
+  }
+  else if (draw)
+    v_[i].store(DRAW, std::memory_order_relaxed);
+  else if (resolve(i, loss))
+    found[loss].push_back(i);
+}
+
+void generator::retrograde(std::uint32_t i, unsigned d, levels &found)
+{
+  for_each_unmove(
+    t_.decode(i),
+    [&](const position &q)
+    {
+      const std::size_t j(t_.entry(q));
+      if (get(j) != UNKNOWN)
+        return;
+
+      if (d % 2 == 0)
+      {
+        if (resolve(j, d + 1))
+          found[d + 1].push_back(j);
+        return;
+      }
+
+      bool lost(true);
+      unsigned longest(0);
+
+      for_each_move(q, [&](const position &r, bool exit)
+                       {
+                         if (!lost)
+                           return;
+
+                         const unsigned x(after(r, exit));
+                         if (x == DRAW || x == UNKNOWN || (x - 1) % 2 == 0)
+                           lost = false;
+                         else
+                           longest = std::max(longest, x);
+                       });
+
+      if (lost && resolve(j, longest))
+        found[longest].push_back(j);
+    });
+}
+
+large_memory generator::run()
+{
+  parallel(threads_, t_.entries(), &level_,
+           [this](std::size_t first, std::size_t last, levels &found)
+           {
+             for (std::size_t i(first); i < last; ++i)
+               initial(static_cast<std::uint32_t>(i), found);
+           });
+
+  for (unsigned d(0); d < LEVELS; ++d)
+  {
+    std::vector<std::uint32_t> current;
+    current.swap(level_[d]);
+
+    // Wins by capture / promotion not improved by in-table moves.
+    std::size_t k(0);
+    for (auto i : current)
+      if (!(i & PENDING) || resolve(i & ~PENDING, d))
+        current[k++] = i & ~PENDING;
+    current.resize(k);
+
+    if (current.empty())
+      continue;
+
+    parallel(threads_, current.size(), &level_,
+             [&](std::size_t first, std::size_t last, levels &found)
+             {
+               for (std::size_t i(first); i < last; ++i)
+                 retrograde(current[i], d, found);
+             });
+  }
+
+  large_memory ret(t_.entries());
+  auto *data(static_cast<std::uint8_t *>(ret.get()));
+
+  for (std::size_t i(0); i < t_.entries(); ++i)
+  {
+    const auto x(get(i));
+    data[i] = x == UNKNOWN ? DRAW : x;
+  }
+
+  return ret;
+}
+
+struct file_header
+{
+  char magic[8];
+  char name[8];
+  std::uint64_t entries;
+};
+
+const char MAGIC[8] = "TTB-DTM";
+
+std::string file_name(const std::string &dir, const std::string &name)
+{
+  return (dir.empty() ? "." : dir) + "/" + name + ".ttb";
+}
+
+bool load(const std::string &dir, const std::string &name)
+{
+  auto t(std::make_unique<table>(name));
+  const std::string file(file_name(dir, name));
+
+  file_header h;
+  {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.read(reinterpret_cast<char *>(&h), sizeof(h)))
+      return false;
+  }
+
+  if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC))
+      || std::strncmp(h.name, name.c_str(), sizeof(h.name))
+      || h.entries != t->entries())
+    return false;
+
+  large_memory m;
+  try
+  {
+    m = large_memory(file);
+  }
+  catch (const std::runtime_error &)
+  {
+    return false;
+  }
+
+  if (m.size() < sizeof(h) + h.entries)
+    return false;
+
+  t->data(std::move(m), sizeof(h));
+  tables.add(std::move(t));
+  return true;
+}
+
+}  // unnamed namespace
+
+std::vector<std::string> materials()
+{
+  // Sides (pieces besides the king, strongest first) with `n` pieces.
+  const auto sides([](unsigned n)
+                   {
+                     std::vector<std::string> ret = {""};
+                     for (unsigned i(0); i < n; ++i)
+                     {
+                       std::vector<std::string> next;
+                       for (const auto &s : ret)
+                         for (auto k(s.empty() ? 0 : ORDER.find(s.back()));
+                              k < ORDER.size(); ++k)
+                           next.push_back(s + ORDER[k]);
+                       ret = next;
+                     }
+                     return ret;
+                   });
+
+  std::vector<std::string> ret;
+
+  for (unsigned n(1); n + 2 <= MAX_PIECES; ++n)
+    for (unsigned strong(n); 2 * strong >= n; --strong)
+      for (const auto &s1 : sides(strong))
+        for (const auto &s2 : sides(n - strong))
+        {
+          const std::string name(canonical(s1, s2));
+
+          if ((s1.find('P') == std::string::npos
+               || s2.find('P') == std::string::npos)
+              && std::find(ret.begin(), ret.end(), name) == ret.end())
+            ret.push_back(name);
+        }
+
+  const auto pawns([](const std::string &name)
+                   {
+                     return std::count(name.begin(), name.end(), 'P');
+                   });
+
+  std::stable_sort(ret.begin(), ret.end(),
+                   [&](const std::string &a, const std::string &b)
+                   {
+                     return a.size() < b.size()
+                            || (a.size() == b.size() && pawns(a) < pawns(b));
+                   });
+  return ret;
+}
+
+// Builds the table for the material configuration `name` (see `materials`)
+// using `threads` threads (`0` means one thread for each core). The tables
+// reached by captures and promotions must be available.
+// The new table is immediately available for probing.
+// Returns `false` if the table cannot be built (unknown material, missing
+// dependencies or mates too long for the format).
+bool generate(const std::string &name, unsigned threads)
+{
+  const auto all(materials());
+  if (std::find(all.begin(), all.end(), name) == all.end())
+    return false;
+
+  for (const auto &d : dependencies(name))
+    if (!available(d))
+      return false;
+
+  threads = thread_count(0, threads, 0);
+
+  auto t(std::make_unique<table>(name));
+  generator g(*t, threads);
+  t->data(g.run(), 0);
+  if (g.overflow())
+    return false;
+
+  tables.add(std::move(t));
+  return true;
+}
+
+// Saves the table `name` in the `dir` directory.
+bool save(const std::string &name, const std::string &dir)
+{
+  const table *t(tables.find(name));
+  if (!t)
+    return false;
+
+  const std::string file(file_name(dir, name)), tmp(file + ".tmp");
+
+  {
+    std::ofstream out(tmp, std::ios::binary);
+
+    file_header h = {};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    std::memcpy(h.name, name.c_str(), std::min(name.size(), sizeof(h.name)));
+    h.entries = t->entries();
+
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    for (std::size_t i(0); i < t->entries(); ++i)
+      out.put(static_cast<char>((*t)[i]));
+
+    if (!out.flush())
+    {
+      std::remove(tmp.c_str());
+      return false;
+    }
+  }
+
+  return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+// Maps in memory the tables found in the `dir` directory (files are named
+// after the material configuration, e.g. `KQKR.ttb`).
+// Returns the number of tables loaded.
+unsigned init(const std::string &dir)
+{
+  unsigned ret(0);
+
+  for (const auto &name : materials())
+    if (load(dir, name))
+      ++ret;
+
+  return ret;
+}
+
+void clear()
+{
+  tables.clear();
+}
+
+bool available(const std::string &name)
+{
+  return tables.find(name);
+}
+
+summary info(const std::string &name)
+{
+  summary ret;
+
+  if (const table *t = tables.find(name))
+    for (std::size_t i(0); i < t->entries(); ++i)
+    {
+      const unsigned x((*t)[i]);
+      if (x == INVALID)
+        continue;
+
+      ++ret.positions;
+
+      if (x != DRAW)
+      {
+        if ((x - 1) % 2)
+        {
+          ++ret.wins;
+          ret.longest = std::max(ret.longest, x - 1);
+        }
+        else
+          ++ret.losses;
+      }
+    }
+
+  return ret;
+}
+
+// Distance to mate of `s` (a mate score relative to the position: `INF - d`
+// when the side to move mates in `d` plies, `-INF + d` when it's mated) or
+// zero for a draw.
+// Returns `false` if `s` isn't covered by the available tables (too many
+// pieces, castling rights...).
+bool probe(const state &s, score *v)
+{
+  if (tables.empty())
+    return false;
+
+  const bitboard occ(s.pieces(WHITE) | s.pieces(BLACK));
+  if (popcount(occ) > MAX_PIECES || s.castle())
+    return false;
+
+  position p;
+  for (bitboard b(occ); b; b &= b - 1)
+  {
+    p.sq[p.n] = lsb(b);
+    p.pc[p.n] = s[p.sq[p.n]];
+    ++p.n;
+  }
+  p.stm = s.side();
+
+  const unsigned x(value(p, s.material_key()));
+  if (x == INVALID)
+    return false;
+
+  if (x == DRAW)
+    *v = 0;
+  else
+  {
+    const score dtm(x - 1);
+    *v = dtm % 2 ? INF - dtm : -INF + dtm;
+  }
+
+  return true;
+}
+
+}  // namespace tablebase
+
+}  // namespace testudo
@@ -0,0 +1,70 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_TABLEBASE_H)
+#define      TESTUDO_TABLEBASE_H
+
+#include <string>
+#include <vector>
+
+#include "state.h"
+
+namespace testudo
+{
+
+// Distance To Mate (DTM) endgame tablebases for every material configuration
+// with up to `MAX_PIECES` pieces (kings included).
+//
+// A table is named after its material configuration, pieces of the stronger
+// side first (e.g. "KQKR", "KRPK"). It stores one byte for every position
+// (both sides to move): the number of plies to mate (or draw). Positions are
+// indexed exploiting the symmetries of the board (the strong king is
+// confined to the a1-d1-d4 triangle for pawnless tables, to the a-d files
+// otherwise).
+//
+// Tables are built by retrograde analysis (see `generate` and the `tbgen`
+// tool) and mapped in memory when loaded from disk (see `init`), so that
+// only the pages really probed are read.
+//
+// Limitations: tables ignore the fifty-move rule and positions with both
+// sides having pawns (KPKP) aren't covered (the en passant capture cannot be
+// represented).
+namespace tablebase
+{
+
+constexpr unsigned MAX_PIECES = 4;
+
+struct summary
+{
+  std::size_t positions = 0;  // legal positions (both sides to move)
+  std::size_t      wins = 0;  // side to move wins
+  std::size_t    losses = 0;  // side to move loses
+  unsigned      longest = 0;  // longest mate (plies)
+};
+
+// Material configurations of the tables, sorted so that every table depends
+// only on the preceding ones.
+std::vector<std::string> materials();
+
+bool generate(const std::string &, unsigned = 0);
+bool save(const std::string &, const std::string &);
+unsigned init(const std::string &);
+void clear();
+
+bool available(const std::string &);
+summary info(const std::string &);
+
+bool probe(const state &, score *);
+
+}  // namespace tablebase
+
+}  // namespace testudo
+
+#endif  // include guard
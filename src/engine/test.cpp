@@ -28,7 +28,10 @@ namespace testudo
 // absolutely correct results, this is not advisable as it could obviously
 // change its mind later on but, for performance analysis, this saves a lot of
 // time.
-bool test(const std::string &epd, const search::constraints &c)
+// `hash_mb` is the size (megabytes) of the hash table (`0` for the default
+// size).
+bool test(const std::string &epd, const search::constraints &c,
+          std::size_t hash_mb)
 {
   std::ifstream f(epd);
   if (!f)
@@ -97,6 +100,8 @@ bool test(const std::string &epd, const search::constraints &c)
       });
 
     cache tt(21);
+    if (hash_mb)
+      tt.size_mb(hash_mb);
     ab_search s({pos}, &tt);
     unsigned correct_for(0);
 
@@ -16,7 +16,8 @@
 namespace testudo
 {
 
-bool test(const std::string &, const search::constraints &);
+bool test(const std::string &, const search::constraints &,
+          std::size_t = 0);
 
 }  // namespace testudo
 
@@ -8,6 +8,10 @@
  *  You can obtain one at http://mozilla.org/MPL/2.0/
  */
 
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
 #include "testudo.h"
 #include "cecp.h"
 #include "test.h"
@@ -28,8 +32,10 @@ Copyright 2018 Manlio Morini
 ////__////__////__////__/
 
 Usage:
-  testudo
-  testudo [--depth=<d>] [--nodes=<n>] [--time=<sec>] --test TESTSET
+  testudo [--hash=<mb>] [--hashfile=<file> | --shared-hash=<name>]
+          [--nnue=<file>] [--egtpath=<dir>]
+  testudo [--depth=<d>] [--nodes=<n>] [--time=<sec>] [--hash=<mb>]
+          [--nnue=<file>] [--egtpath=<dir>] --test TESTSET
   testudo -h | --help
   testudo -v | --version
 
@@ -40,6 +46,11 @@ Options:
   --depth=<d>            maximum allowed search depth
   --nodes=<n>            available number of search nodes
   --time=<sec>           available search time (seconds)
+  --hash=<mb>            size of the hash table (megabytes)
+  --hashfile=<file>      hash table file (loaded at startup, saved on exit)
+  --shared-hash=<name>   hash table shared among processes (shared memory)
+  --nnue=<file>          evaluates positions with the given neural network
+  --egtpath=<dir>        directory of the endgame tablebases (see `tbgen`)
 )";
 
 int main(int argc, char *const argv[])
@@ -54,9 +65,45 @@ int main(int argc, char *const argv[])
                                  VERSION,   // version string
                                  false));   // options first (POSIX compliant)
 
+  std::size_t hash_mb(0);
+  const auto hash(args.at("--hash"));
+  if (hash)
+  {
+    long mb(0);
+    try
+    {
+      mb = hash.asLong();
+    }
+    catch (const std::exception &)  // non-numeric or out of range
+    {
+    }
+
+    if (mb <= 0)
+    {
+      std::cerr << "Invalid hash table size (MB): " << hash.asString() << '\n';
+      return EXIT_FAILURE;
+    }
+
+    hash_mb = static_cast<std::size_t>(mb) > cache::MAX_MB ? cache::MAX_MB
+                                                            : mb;
+  }
+
+  const auto nnue_file(args.at("--nnue"));
+  if (nnue_file)
+    nnue::use(nnue_file.asString());
+
+  const auto egtpath(args.at("--egtpath"));
+  if (egtpath)
+    tablebase::init(egtpath.asString());
+
   const auto testfile(args.at("--test"));
   if (!testfile)
-    CECP::loop();
+  {
+    const auto hash_file(args.at("--hashfile"));
+    const auto shared_hash(args.at("--shared-hash"));
+    CECP::loop(hash_mb, hash_file ? hash_file.asString() : "",
+               shared_hash ? shared_hash.asString() : "");
+  }
   else
   {
     search::constraints constraints;
@@ -73,6 +120,6 @@ int main(int argc, char *const argv[])
     if (nodes)
       constraints.max_nodes = nodes.asLong();
 
-    test(testfile.asString(), constraints);
+    test(testfile.asString(), constraints, hash_mb);
   }
 }
@@ -12,13 +12,22 @@
 #define      TESTUDO_H
 
 #include "ab_search.h"
+#include "attacks.h"
+#include "bitboard.h"
+#include "endgame.h"
 #include "eval.h"
+#include "features.h"
 #include "game.h"
+#include "kpk.h"
 #include "log.h"
+#include "material.h"
+#include "nnue.h"
 #include "parameters.h"
 #include "random.h"
 #include "san.h"
 #include "search.h"
+#include "tablebase.h"
+#include "tuner.h"
 
 namespace testudo
 {
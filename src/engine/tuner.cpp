@@ -0,0 +1,289 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <istream>
+#include <numeric>
+#include <sstream>
+
+#include "tuner.h"
+#include "eval.h"
+#include "util.h"
+
+namespace testudo
+{
+
+namespace tuner
+{
+
+namespace
+{
+
+constexpr std::size_t MIN_PER_THREAD = 1024;  // samples
+
+// Fail-soft quiescence search (see `ab_search::quiesce`) also returning the
+// last position of the principal variation.
+score quiesce(const state &s, score alpha, score beta, const parameters &p,
+              state &leaf)
+{
+  assert(alpha < beta);
+
+  score best(eval(s, p));
+  leaf = s;
+
+  if (best >= beta)
+    return best;
+  if (best > alpha)
+    alpha = best;
+
+  auto captures(s.captures());
+  std::sort(captures.begin(), captures.end(),
+            [&s](const move &m1, const move &m2)
+            {
+              return 20 * s[m1.to].value() - s[m1.from].value()
+                     > 20 * s[m2.to].value() - s[m2.from].value();
+            });
+
+  for (const auto &m : captures)
+  {
+    state pv_leaf(state::setup::empty);
+    const score x(-quiesce(s.after_move(m), -beta, -alpha, p, pv_leaf));
+
+    if (x > best)
+    {
+      best = x;
+
+      if (x > alpha)
+      {
+        leaf = pv_leaf;
+
+        if (x >= beta)
+          return x;
+        alpha = x;
+      }
+    }
+  }
+
+  return best;
+}
+
+// Extracts the game result from the part of an EPD line following the
+// position. Both the `c9 "1-0";` style and the `[1.0]` style are supported.
+bool parse_result(const std::string &s, double &r)
+{
+  const auto open(s.find('['));
+  if (open != std::string::npos)
+  {
+    std::istringstream ss(s.substr(open + 1));
+    return !!(ss >> r) && 0.0 <= r && r <= 1.0;
+  }
+
+  if (s.find("1/2-1/2") != std::string::npos)
+    r = 0.5;
+  else if (s.find("1-0") != std::string::npos)
+    r = 1.0;
+  else if (s.find("0-1") != std::string::npos)
+    r = 0.0;
+  else
+    return false;
+
+  return true;
+}
+
+double sigmoid(double k, score q)
+{
+  return 1.0 / (1.0 + std::pow(10.0, -k * q / 400.0));
+}
+
+}  // unnamed namespace
+
+const std::vector<std::string> SECTIONS = {"pcsq", "pawn", "pp_adj",
+                                           "activity"};
+
+// Position at the end of the principal variation of the quiescence search
+// starting from `s` (i.e. the position whose static evaluation is the
+// quiescence score of `s`).
+state quiet(const state &s, const parameters &p)
+{
+  state leaf(state::setup::empty);
+  quiesce(s, -INF, +INF, p, leaf);
+  return leaf;
+}
+
+// Reads labelled positions from `in` (one EPD line per position, with the
+// game result) and appends their quiet version to `samples`. Lines that
+// cannot be parsed are skipped.
+// The input is streamed: only the resolved positions are kept in memory.
+// Returns the number of positions read.
+std::size_t read(std::istream &in, std::vector<sample> &samples,
+                 const parameters &p)
+{
+  std::size_t n(0);
+
+  std::string line;
+  while (std::getline(in, line))
+  {
+    std::istringstream ss(line);
+
+    std::string placement, stm, castling, ep;
+    if (!(ss >> placement >> stm >> castling >> ep))
+      continue;
+
+    std::string rest;
+    std::getline(ss, rest);
+
+    double result;
+    if (!parse_result(rest, result))
+      continue;
+
+    try
+    {
+      const state pos(placement + " " + stm + " " + castling + " " + ep);
+      samples.push_back({quiet(pos, p), result});
+      ++n;
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+  }
+
+  return n;
+}
+
+// Mean squared error of the predictions of the evaluation function using
+// parameters `p` and scaling constant `k`.
+// Samples are split among `threads` threads (`0` means one thread for each
+// core).
+double error(const std::vector<sample> &samples, const parameters &p,
+             double k, unsigned threads)
+{
+  const std::size_t n(samples.size());
+  if (!n)
+    return 0.0;
+
+  std::vector<double> partial(thread_count(n, threads, MIN_PER_THREAD), 0.0);
+
+  parallel_for(n, threads, MIN_PER_THREAD,
+               [&](unsigned t, std::size_t from, std::size_t to)
+               {
+                 double sum(0.0);
+
+                 for (std::size_t i(from); i < to; ++i)
+                 {
+                   const state &s(samples[i].position);
+                   const score q(eval(s, p));
+                   const double d(samples[i].result
+                                  - sigmoid(k, s.side() == WHITE ? q : -q));
+                   sum += d * d;
+                 }
+
+                 partial[t] = sum;
+               });
+
+  return std::accumulate(partial.begin(), partial.end(), 0.0) / n;
+}
+
+// The scaling constant minimizing the error for the given parameters (golden
+// section search, the error is unimodal in `k`).
+double best_k(const std::vector<sample> &samples, const parameters &p,
+              unsigned threads)
+{
+  const double phi((std::sqrt(5.0) - 1.0) / 2.0);
+
+  double a(0.0), b(4.0);
+  double x1(b - phi * (b - a)), x2(a + phi * (b - a));
+  double e1(error(samples, p, x1, threads));
+  double e2(error(samples, p, x2, threads));
+
+  while (b - a > 0.001)
+    if (e1 < e2)
+    {
+      b = x2;
+      x2 = x1;
+      e2 = e1;
+      x1 = b - phi * (b - a);
+      e1 = error(samples, p, x1, threads);
+    }
+    else
+    {
+      a = x1;
+      x1 = x2;
+      e1 = e2;
+      x2 = a + phi * (b - a);
+      e2 = error(samples, p, x2, threads);
+    }
+
+  return (a + b) / 2.0;
+}
+
+// Local search (the parameters are small integers used to build the
+// evaluation tables, so there isn't a meaningful gradient): every value of
+// the `SECTIONS` of `start` is changed by +1 / -1 and the change is kept if
+// the error decreases. The process is repeated until there is no improvement
+// or `iterations` passes are performed.
+// Parameter sets are built from their JSON representation, so the clamping
+// rules of `parameters::load` are always respected.
+parameters tune(const std::vector<sample> &samples, const parameters &start,
+                double k, unsigned iterations, unsigned threads,
+                const progress &report)
+{
+  nlohmann::json j;
+  start.save(j);
+
+  std::vector<nlohmann::json *> values;
+  for (const auto &sec : SECTIONS)
+    for (auto &v : j[sec])
+      if (v.is_array())
+        for (auto &x : v)
+          values.push_back(&x);
+      else
+        values.push_back(&v);
+
+  double best(error(samples, start, k, threads));
+
+  for (unsigned i(0); i < iterations; ++i)
+  {
+    bool improved(false);
+
+    for (auto *v : values)
+    {
+      const int current(*v);
+
+      for (int delta : {+1, -1})
+      {
+        *v = current + delta;
+
+        const double e(error(samples, parameters(j), k, threads));
+        if (e < best)
+        {
+          best = e;
+          improved = true;
+          break;
+        }
+
+        *v = current;
+      }
+    }
+
+    if (report)
+      report(i + 1, best);
+
+    if (!improved)
+      break;
+  }
+
+  return parameters(j);
+}
+
+}  // namespace tuner
+
+}  // namespace testudo
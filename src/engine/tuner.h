@@ -0,0 +1,71 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#if !defined(TESTUDO_TUNER_H)
+#define      TESTUDO_TUNER_H
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "parameters.h"
+#include "state.h"
+
+namespace testudo
+{
+
+// Texel's tuning method (Peter Osterlund): the evaluation parameters are
+// optimized minimizing the error
+//
+//     E = 1/N sum_i (R_i - sigmoid(q_i))^2
+//     sigmoid(q) = 1 / (1 + 10^(-K q / 400))
+//
+// where `R_i` is the result of the game the i-th position comes from (`1`
+// WHITE wins, `0.5` draw, `0` BLACK wins) and `q_i` is the quiescence score
+// of the position (WHITE point of view).
+//
+// Positions are resolved once (leaf of the principal variation of the
+// quiescence search) so computing `E` only requires static evaluations, which
+// are performed in parallel with a `const parameters &` (see
+// `eval(const state &, const parameters &)`).
+namespace tuner
+{
+
+struct sample
+{
+  state position;  // a quiet position
+  double result;   // from WHITE point of view
+};
+
+// Tunable sections of the parameter file.
+extern const std::vector<std::string> SECTIONS;
+
+state quiet(const state &, const parameters &);
+
+std::size_t read(std::istream &, std::vector<sample> &,
+                 const parameters & = db);
+
+double error(const std::vector<sample> &, const parameters &, double,
+             unsigned = 0);
+double best_k(const std::vector<sample> &, const parameters &,
+              unsigned = 0);
+
+// Called after every improvement (iteration, current error).
+using progress = std::function<void (unsigned, double)>;
+
+parameters tune(const std::vector<sample> &, const parameters &, double,
+                unsigned, unsigned = 0, const progress & = nullptr);
+
+}  // namespace tuner
+
+}  // namespace testudo
+
+#endif  // include guard
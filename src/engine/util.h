@@ -11,7 +11,11 @@
 #if !defined(TESTUDO_UTIL_H)
 #define      TESTUDO_UTIL_H
 
+#include <algorithm>
+#include <cstddef>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace testudo
 {
@@ -50,6 +54,45 @@ inline final_action<F> finally(F f) noexcept
 
 std::string trim(const std::string &);
 
+// Number of threads used by `parallel_for` to process `n` elements:
+// `threads` (`0` means one thread for each core) reduced so that no thread
+// gets less than `min_per_thread` elements (`0` disables the limit).
+inline unsigned thread_count(std::size_t n, unsigned threads,
+                             std::size_t min_per_thread) noexcept
+{
+  if (!threads)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  if (min_per_thread)
+    threads = static_cast<unsigned>(
+      std::min<std::size_t>(threads,
+                            std::max<std::size_t>(1, n / min_per_thread)));
+
+  return threads;
+}
+
+// Splits `[0, n)` into contiguous ranges processed concurrently (see
+// `thread_count`): `f(t, first, last)` is called once for every thread `t`
+// (the calling thread is `0`, so `t` can index per-thread data).
+template<class F>
+void parallel_for(std::size_t n, unsigned threads, std::size_t min_per_thread,
+                  F f)
+{
+  threads = thread_count(n, threads, min_per_thread);
+
+  std::vector<std::thread> pool;
+  for (unsigned t(1); t < threads; ++t)
+    pool.emplace_back([&f, n, t, threads]
+                      {
+                        f(t, n * t / threads, n * (t + 1) / threads);
+                      });
+
+  f(0u, std::size_t(0), n / threads);
+
+  for (auto &t : pool)
+    t.join();
+}
+
 }  // namespace testudo
 
 #endif  // include guard
@@ -47,6 +47,46 @@ hash_t hash(const state &s) noexcept
   return ret;
 }
 
+// Material key: the `n` pieces of a given type are keyed as if they were on
+// squares `0...n-1` (see `state::material_key`).
+hash_t material_hash(const state &s) noexcept
+{
+  hash_t ret(0);
+
+  for (const color c : {BLACK, WHITE})
+    for (const auto t : {piece::pawn, piece::knight, piece::bishop,
+                         piece::rook, piece::queen})
+    {
+      const auto id(testudo::piece(c, t).id());
+
+      for (unsigned i(0); i < s.piece_count(c, t); ++i)
+        ret ^= piece[id][i];
+    }
+
+  return ret;
+}
+
+// A fingerprint of the whole key set. Hash keys (e.g. the ones stored in a
+// transposition table file) are comparable only among programs sharing the
+// same key set.
+hash_t identity() noexcept
+{
+  hash_t ret(0);
+
+  const auto mix([&ret](hash_t k) { ret = ((ret << 1) | (ret >> 63)) ^ k; });
+
+  for (const auto &keys : piece)
+    for (const auto k : keys)
+      mix(k);
+  mix(side);
+  for (const auto k : ep)
+    mix(k);
+  for (const auto k : castle)
+    mix(k);
+
+  return ret;
+}
+
 }  // namespace zobrist
 
 }  // namespace testudo
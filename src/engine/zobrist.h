@@ -43,6 +43,8 @@ extern const std::array<hash_t, 8> ep;
 extern const std::array<hash_t, 16> castle;
 
 hash_t hash(const state &) noexcept;
+hash_t material_hash(const state &) noexcept;
+hash_t identity() noexcept;
 
 }  // namespace zobrist
 
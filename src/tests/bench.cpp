@@ -12,6 +12,7 @@
 
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 
 #include "engine/testudo.h"
 
@@ -25,6 +26,8 @@ std::chrono::seconds bench()
   using namespace testudo;
   using namespace std::chrono;
 
+  const std::size_t HASH_MB(1024);
+
   struct test_elem
   {
     testudo::state state;
@@ -71,18 +74,228 @@ std::chrono::seconds bench()
     std::uintmax_t qnodes = 0;
     move best_move = move::sentry();
     score val = 0;
+    unsigned researches = 0;
+    std::uintmax_t research_nodes = 0;
+    cache::statistics tt = cache::statistics();
+    unsigned hashfull = 0;
+    eval_cache::statistics ec = eval_cache::statistics();
   };
   std::vector<result> results;
 
   std::cout << "Running benchmark...\n\n";
 
+  // Latency of engine startup (allocation and first clear of the hash table)
+  // and of a full clear of the hash table.
+  {
+    timer t;
+    cache tt;
+    tt.size_mb(HASH_MB);
+    const auto startup(t.elapsed());
+
+    t.restart();
+    tt.clear();
+    const auto new_game(t.elapsed());
+
+    std::cout << "Hash table " << tt.size_mb() << "MB - startup: "
+              << startup.count() << "ms, clear: " << new_game.count()
+              << "ms\n\n";
+  }
+
+  // Speed of the static evaluation (classical and neural network based) on
+  // the positions one and two plies away from the test positions. There is
+  // no trained network, so random weights are used (they don't affect the
+  // speed).
+  {
+    nnue::net.randomize();
+
+    std::vector<state> positions;
+    for (const auto &p : db)
+      for (const auto &m1 : p.state.moves())
+      {
+        state s1(p.state);
+        if (!s1.make_move(m1))
+          continue;
+        positions.push_back(s1);
+
+        for (const auto &m2 : s1.moves())
+        {
+          state s2(s1);
+          if (s2.make_move(m2))
+            positions.push_back(s2);
+        }
+      }
+
+    const auto evals_per_second(
+      [&positions](bool neural)
+      {
+        const unsigned ROUNDS(20);
+        volatile score sink(0);
+
+        nnue::enable(neural);
+
+        timer t;
+        for (unsigned r(0); r < ROUNDS; ++r)
+          for (const auto &s : positions)
+            sink = sink + eval(s);
+        const auto elapsed(std::max<long long>(t.elapsed().count(), 1));
+
+        nnue::enable(false);
+
+        return positions.size() * ROUNDS * 1000 / elapsed;
+      });
+
+    const auto classical(evals_per_second(false));
+
+    std::cout << "Evaluation - classical: " << classical
+              << " evals/s, NNUE: " << evals_per_second(true)
+              << " evals/s\n";
+
+    // Cost of the attack maps (built once per evaluated node and shared by
+    // the mobility and king attack terms). They shouldn't take more than
+    // `ATTACK_BUDGET` percent of the classical evaluation time.
+    {
+      const unsigned ATTACK_BUDGET(60);
+      const unsigned ROUNDS(20);
+      volatile bitboard sink(0);
+
+      timer t;
+      for (unsigned r(0); r < ROUNDS; ++r)
+        for (const auto &s : positions)
+          sink = sink ^ attack_map(s).attacked2[WHITE];
+      const auto elapsed(std::max<long long>(t.elapsed().count(), 1));
+
+      const auto maps(positions.size() * ROUNDS * 1000 / elapsed);
+      const auto share(classical * 100 / std::max<decltype(maps)>(maps, 1));
+
+      std::cout << "Attack maps: " << maps << " maps/s, " << share
+                << "% of the evaluation time (budget " << ATTACK_BUDGET
+                << "%)" << (share > ATTACK_BUDGET ? " OVER BUDGET" : "")
+                << '\n';
+    }
+
+    // Throughput of the batch evaluation (e.g. rescoring of large EPD
+    // files).
+    std::vector<state> batch;
+    while (batch.size() < 500000)
+      batch.insert(batch.end(), positions.begin(), positions.end());
+
+    const auto batch_per_second(
+      [&batch](unsigned threads)
+      {
+        std::vector<score> scores(batch.size());
+
+        timer t;
+        eval_batch(batch, scores, threads);
+        const auto elapsed(std::max<long long>(t.elapsed().count(), 1));
+
+        return batch.size() * 1000 / elapsed;
+      });
+
+    std::cout << "Batch evaluation - single thread: " << batch_per_second(1)
+              << " positions/s, all cores: " << batch_per_second(0)
+              << " positions/s\n";
+
+    // Throughput of the feature extraction (pre-extraction of training sets
+    // in the binary cache format).
+    {
+      std::ostringstream cache;
+      feature_vector fv;
+
+      timer t;
+      for (const auto &s : batch)
+      {
+        features(s, fv);
+        fv.save(cache);
+      }
+      const auto elapsed(std::max<long long>(t.elapsed().count(), 1));
+
+      std::cout << "Feature extraction: " << batch.size() * 1000 / elapsed
+                << " positions/s, " << cache.str().size() / batch.size()
+                << " bytes/position\n\n";
+    }
+
+    nnue::net = nnue::network();
+  }
+
+  // Nodes needed to solve a small set of endgames: mate for the won ones,
+  // a draw score for the drawn ones (specialised endgame knowledge should
+  // make the latter almost immediate).
+  {
+    struct endgame_elem
+    {
+      const char *name;
+      testudo::state state;
+      bool win;
+    };
+    const std::vector<endgame_elem> endgames(
+    {
+      {"KQK",  state("8/8/8/4k3/8/8/8/3QK3 w - -"),    true},
+      {"KRK",  state("8/8/8/8/8/2k5/8/R3K3 w - -"),    true},
+      {"KPK",  state("k7/8/8/8/8/8/P7/4K3 w - -"),    false},
+      {"KPK2", state("8/4k3/8/4K3/4P3/8/8/8 w - -"),  false},
+      {"KBPK", state("7k/8/8/8/8/8/7P/3BK3 w - -"),   false},
+      {"KBKN", state("4k3/8/8/8/8/8/8/2B1K1n1 w - -"), false}
+    });
+
+    // The KPK bitbase is built on first use.
+    {
+      timer t;
+      kpk::probe(E1, E2, E8, WHITE);
+      std::cout << "KPK bitbase: " << t.elapsed().count() << "ms\n";
+    }
+
+    const std::uintmax_t MAX_NODES(4000000);
+    std::uintmax_t total(0);
+    unsigned solved(0);
+
+    // Quiet searches (fail high / low lines are printed anyway).
+    const auto level(log::reporting_level);
+    log::reporting_level = log::WARNING;
+
+    std::cout << "Endgames (nodes to solution):";
+    for (const auto &e : endgames)
+    {
+      cache tt(21);
+      ab_search s({e.state}, &tt);
+
+      const auto is_solved(
+        [&s, &e]
+        {
+          const score v(s.stats.score_at_root);
+          return e.win ? is_mate(v) && v > 0 : v == 0;
+        });
+
+      s.constraint.max_nodes = MAX_NODES;
+      s.constraint.condition = is_solved;
+      s.run(false);
+
+      const auto nodes(s.stats.snodes + s.stats.qnodes);
+      total += nodes;
+
+      std::cout << ' ' << e.name << ' ';
+      if (is_solved())
+      {
+        ++solved;
+        std::cout << nodes;
+      }
+      else
+        std::cout << "unsolved";
+    }
+
+    log::reporting_level = level;
+
+    std::cout << " - solved " << solved << '/' << endgames.size()
+              << ", total nodes " << total << "\n\n";
+  }
+
   for (const auto &p : db)
   {
     std::cout << p.state;
     cache tt(21);
+    eval_cache ec;
 
     timer t;
-    ab_search s({p.state}, &tt);
+    ab_search s({p.state}, &tt, &ec);
 
     s.constraint.max_time  = milliseconds(0);
     s.constraint.max_depth = p.depth;
@@ -90,7 +303,9 @@ std::chrono::seconds bench()
     const auto m(s.run(true));
 
     results.push_back({duration_cast<seconds>(t.elapsed()),
-          s.stats.snodes, s.stats.qnodes, m, s.stats.score_at_root});
+          s.stats.snodes, s.stats.qnodes, m, s.stats.score_at_root,
+          s.stats.fail_low + s.stats.fail_high, s.stats.research_nodes,
+          s.stats.tt, s.stats.hashfull, s.stats.ec});
 
     std::cout << '\n';
   }
@@ -117,18 +332,28 @@ std::chrono::seconds bench()
                 << std::left << std::setw(6) << std::setfill(' ')
                 << r.best_move << ' '
                 << std::right << std::setw(6) << std::setfill(' ') << r.val
-                << '\n';
+                << ' '
+                << std::right << std::setw(4) << std::setfill(' ')
+                << r.researches << ' '
+                << std::right << std::setw(12) << std::setfill(' ')
+                << r.research_nodes << '\n';
 
       if (!r.best_move.is_sentry())
         out << r.time.count() << ','
             << r.snodes << ',' << r.qnodes << ','
             << nps(r.snodes + r.qnodes, r.time) << ','
-            << r.best_move << ',' << r.val << '\n';
+            << r.best_move << ',' << r.val << ','
+            << r.researches << ',' << r.research_nodes << ','
+            << r.tt.probes << ',' << r.tt.hits << ',' << r.tt.cutoffs << ','
+            << r.tt.always_replace << ',' << r.tt.depth_preferred << ','
+            << r.tt.same_key << ',' << r.hashfull << ','
+            << r.ec.probes << ',' << r.ec.hits << '\n';
     });
 
   int n(0);
   seconds total_time(0);
-  std::uintmax_t snodes(0), qnodes(0);
+  std::uintmax_t snodes(0), qnodes(0), research_nodes(0);
+  unsigned researches(0);
   score val(0);
   for (const auto &r : results)
   {
@@ -138,6 +363,8 @@ std::chrono::seconds bench()
     snodes += r.snodes;
     qnodes += r.qnodes;
     val += r.val;
+    researches += r.researches;
+    research_nodes += r.research_nodes;
 
     ++n;
   }
@@ -145,7 +372,8 @@ std::chrono::seconds bench()
   val = val / n;
 
   std::cout << std::string(70, '-') << '\n';
-  print(result{total_time, snodes, qnodes, move::sentry(), val});
+  print(result{total_time, snodes, qnodes, move::sentry(), val,
+               researches, research_nodes});
 
   return total_time;
 }
@@ -10,7 +10,12 @@
  *  You can obtain one at http://mozilla.org/MPL/2.0/
  */
 
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <memory>
 #include <set>
+#include <sstream>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "thirdparty/doctest.h"
@@ -250,6 +255,106 @@ TEST_CASE("square")
   CHECK(to_square(FILE_H, 9) == NO_SQ);
 }
 
+TEST_CASE("bitboard")
+{
+  CHECK(popcount(0) == 0);
+  CHECK(popcount(FILE_A_BB) == 8);
+  CHECK(popcount(~bitboard(0)) == 64);
+
+  for (square sq(0); sq < 64; ++sq)
+  {
+    CHECK((bb(sq) & file_bb(file(sq))));
+    CHECK((bb(sq) & rank_bb(WHITE, rank(sq))));
+    CHECK((bb(sq) & rank_bb(BLACK, rank(BLACK, sq))));
+
+    if (rank(WHITE, sq) < 7)
+      CHECK(shift_fwd(WHITE, bb(sq)) == bb(sq - 8));
+    if (rank(BLACK, sq) < 7)
+      CHECK(shift_fwd(BLACK, bb(sq)) == bb(sq + 8));
+
+    CHECK(shift_east(bb(sq)) == (file(sq) < FILE_H ? bb(sq + 1) : 0));
+    CHECK(shift_west(bb(sq)) == (file(sq) > FILE_A ? bb(sq - 1) : 0));
+
+    CHECK(popcount(fill_fwd(WHITE, bb(sq))) == 8 - rank(WHITE, sq));
+    CHECK(popcount(fill_bwd(WHITE, bb(sq))) == rank(WHITE, sq) + 1);
+    CHECK((fill_fwd(BLACK, bb(sq)) | fill_bwd(BLACK, bb(sq)))
+          == file_bb(file(sq)));
+  }
+}
+
+TEST_CASE("attack_map")
+{
+  // Single pieces on an empty board.
+  CHECK(popcount(knight_attacks(A8)) == 2);
+  CHECK(popcount(knight_attacks(E4)) == 8);
+  CHECK(popcount(king_attacks(H1)) == 3);
+  CHECK(popcount(bishop_attacks(D4, 0)) == 13);
+  CHECK(popcount(rook_attacks(A1, 0)) == 14);
+  CHECK(rook_attacks(A1, bb(A4) | bb(C1))
+        == (bb(A2) | bb(A3) | bb(A4) | bb(B1) | bb(C1)));
+  CHECK(bishop_attacks(H8, bb(F6)) == (bb(G7) | bb(F6)));
+
+  for (const auto &test : test_set())
+    foreach_game(10, test.state,
+                 [](const state &pos, const move &)
+                 {
+                   for (square i(0); i < 64; ++i)
+                     for (unsigned c(0); c < 2; ++c)
+                     {
+                       CHECK(!!(pos.pieces(c) & bb(i))
+                             == (pos[i].color() == c));
+                       if (pos[i] != EMPTY)
+                         CHECK(!!(pos.pieces(c, pos[i].type()) & bb(i))
+                               == (pos[i].color() == c));
+                     }
+
+                   const attack_map am(pos);
+
+                   // Number of attackers of every square (the single attack
+                   // sets of pawns and kings aren't part of the map).
+                   unsigned n[2][64] = {};
+                   for (square i(0); i < 64; ++i)
+                     if (pos[i].type() == piece::pawn
+                         || pos[i].type() == piece::king)
+                     {
+                       const color c(pos[i].color());
+                       const bitboard to(pos[i].type() == piece::pawn
+                                         ? pawn_attacks(c, bb(i))
+                                         : king_attacks(i));
+                       for (square j(0); j < 64; ++j)
+                         n[c][j] += !!(to & bb(j));
+                     }
+
+                   for (unsigned c(0); c < 2; ++c)
+                   {
+                     CHECK(am.list_size[c] ==
+                           popcount(am.occupancy[c]
+                                    & ~am.pieces[c][piece::pawn]
+                                    & ~am.pieces[c][piece::king]));
+
+                     bitboard all(0);
+                     for (const auto b : am.attacked_by[c])
+                       all |= b;
+                     CHECK(all == am.attacked[c]);
+
+                     for (unsigned i(0); i < am.list_size[c]; ++i)
+                     {
+                       const auto &pa(am.list[c][i]);
+                       CHECK(pos[pa.from] == piece(c, pa.type));
+
+                       for (square j(0); j < 64; ++j)
+                         n[c][j] += !!(pa.to & bb(j));
+                     }
+
+                     for (square j(0); j < 64; ++j)
+                     {
+                       CHECK(!!(am.attacked[c] & bb(j)) == pos.attack(j, c));
+                       CHECK(!!(am.attacked2[c] & bb(j)) == (n[c][j] > 1));
+                     }
+                   }
+                 });
+}
+
 TEST_CASE("piece")
 {
   CHECK(EMPTY.color() != BLACK);
@@ -500,6 +605,17 @@ TEST_CASE("hash_update")
     CHECK(hash_tree(test.state, test.moves.size()));
 }
 
+TEST_CASE("hash_key_after")
+{
+  for (const auto &test : test_set())
+    foreach_game(10, test.state,
+                 [](const state &pos, const move &)
+                 {
+                   for (const auto &m : pos.moves())
+                     CHECK(pos.key_after(m) == pos.after_move(m).hash());
+                 });
+}
+
 TEST_CASE("hash_store_n_probe")
 {
   cache tt(20);
@@ -523,10 +639,208 @@ TEST_CASE("hash_store_n_probe")
                });
 }
 
+TEST_CASE("hash_statistics")
+{
+  if (!cache::stats_enabled)
+    return;
+
+  cache tt(10);
+  tt.inc_age();
+
+  const state s(state::setup::start);
+  const auto m(s.moves().front());
+
+  CHECK(!tt.find(s.hash()));
+  tt.insert(s.hash(), m, 1, score_type::exact, 0);
+  CHECK(tt.find(s.hash()));
+  tt.insert(s.hash(), m, 2, score_type::exact, 0);
+
+  // A different position sharing the same element.
+  const hash_t other(s.hash() ^ (hash_t(1) << 62));
+  tt.insert(other, m, 1, score_type::exact, 0);
+
+  CHECK(tt.stats.probes == 2);
+  CHECK(tt.stats.hits == 1);
+  CHECK(tt.stats.same_key == 2);
+  CHECK(tt.stats.always_replace == 1);
+  CHECK(tt.stats.depth_preferred == 0);
+  CHECK(tt.hashfull() > 0);
+}
+
+TEST_CASE("hash_save_n_load")
+{
+  const std::string file("unittest_hash.tmp");
+
+  cache tt(16);
+  std::vector<std::pair<state, move>> stored;
+
+  foreach_game(100, state(state::setup::start),
+               [&](const state &pos, const move &m)
+               {
+                 tt.insert(pos.hash(), m, pos.hash() & 0xFF,
+                           score_type::exact, pos.hash() & 0xFFF);
+                 stored.emplace_back(pos, m);
+               });
+
+  CHECK(tt.save(file));
+
+  cache tt2(10);
+  CHECK(tt2.load(file));
+  CHECK(tt2.size_mb() == tt.size_mb());
+
+  for (const auto &sm : stored)
+  {
+    const auto *s1(tt.find(sm.first.hash()));
+    const auto *s2(tt2.find(sm.first.hash()));
+
+    CHECK(!s1 == !s2);
+    if (s1 && s2)
+    {
+      CHECK(s1->best_move() == s2->best_move());
+      CHECK(s1->draft() == s2->draft());
+      CHECK(s1->value() == s2->value());
+    }
+  }
+
+  // CECP order: the hash file is loaded at startup, then the GUI sends the
+  // `memory` (same size) and `new` commands. The content is preserved.
+  {
+    game g;
+    CHECK(g.load_hash(file));
+    g.hash_size(tt.size_mb());
+    g.new_game();
+
+    const std::string file2(file + "2");
+    CHECK(g.save_hash(file2));
+
+    cache tt3(10);
+    CHECK(tt3.load(file2));
+    std::remove(file2.c_str());
+
+    for (const auto &sm : stored)
+    {
+      const auto *s1(tt.find(sm.first.hash()));
+      const auto *s3(tt3.find(sm.first.hash()));
+
+      CHECK(!s1 == !s3);
+      if (s1 && s3)
+        CHECK(s1->best_move() == s3->best_move());
+    }
+  }
+
+  // A file with a different key set is rejected.
+  const auto k(zobrist::piece[1][0]);
+  zobrist::piece[1][0] = ~k;
+  CHECK(!tt2.load(file));
+  zobrist::piece[1][0] = k;
+
+  CHECK(!tt2.load(file + ".missing"));
+
+  std::remove(file.c_str());
+}
+
+#if defined(UNIX)
+TEST_CASE("hash_shared")
+{
+  const std::string name("testudo_unittest");
+
+  {
+    cache tt1(16), tt2(10);
+    CHECK(tt1.share(name));
+    CHECK(tt2.share(name));
+    CHECK(tt1.shared());
+    CHECK(tt2.size_mb() == tt1.size_mb());
+
+    foreach_game(100, state(state::setup::start),
+                 [&](const state &pos, const move &m)
+                 {
+                   tt1.insert(pos.hash(), m, 1, score_type::exact,
+                              pos.hash() & 0xFFF);
+
+                   const auto *slot(tt2.find(pos.hash()));
+                   CHECK(slot);
+                   CHECK(slot->best_move() == m);
+                   CHECK(slot->value() == (pos.hash() & 0xFFF));
+                 });
+
+    // Processes share the age: a deep entry of the current search isn't
+    // replaced by a shallower one stored by another process.
+    tt2.inc_age();
+    const move m(state(state::setup::start).moves().front());
+    const hash_t h1(0x123456789), h2(h1 ^ (hash_t(1) << 63));
+    tt1.insert(h1, m, 10, score_type::exact, 0);
+    tt2.insert(h2, m, 1, score_type::exact, 0);
+    CHECK(tt1.find(h1));
+    CHECK(tt2.find(h2));
+
+    // A shared table cannot be resized.
+    const auto mb(tt1.size_mb());
+    tt1.size_mb(2 * mb);
+    CHECK(tt1.shared());
+    CHECK(tt1.size_mb() == mb);
+
+    // Detaching a process doesn't affect the others.
+    {
+      cache tt3(10);
+      CHECK(tt3.share(name));
+    }
+    CHECK(tt2.shared());
+    CHECK(tt2.find(state(state::setup::start).hash()));
+
+    // A new process attaches to the existing segment.
+    cache tt4(10);
+    CHECK(tt4.share(name));
+    CHECK(tt4.size_mb() == mb);
+  }
+
+  // The last process detaching removes the segment.
+  bool created;
+  {
+    const auto m(large_memory::shared("/" + name, 4096, &created));
+    CHECK(created);
+  }
+
+  // The creator of the segment died before initializing it (the segment
+  // created above): it's replaced.
+  cache tt5(10);
+  CHECK(tt5.share(name));
+  CHECK(tt5.size_mb() == 0);
+}
+#endif
+
 }  // TEST_SUITE "BASE"
 
 TEST_SUITE("EVAL")
 {
+TEST_CASE("packed_score")
+{
+  for (unsigned i(0); i < 10000; ++i)
+  {
+    const score mg1(random::between(-3000, 3000));
+    const score eg1(random::between(-3000, 3000));
+    const score mg2(random::between(-3000, 3000));
+    const score eg2(random::between(-3000, 3000));
+    const int n(random::between(-3, 3));
+
+    const packed_score p1(mg1, eg1), p2(mg2, eg2);
+    CHECK(p1.mg() == mg1);
+    CHECK(p1.eg() == eg1);
+
+    CHECK((p1 + p2).mg() == mg1 + mg2);
+    CHECK((p1 + p2).eg() == eg1 + eg2);
+    CHECK((p1 - p2).mg() == mg1 - mg2);
+    CHECK((p1 - p2).eg() == eg1 - eg2);
+    CHECK((-p1).mg() == -mg1);
+    CHECK((-p1).eg() == -eg1);
+    CHECK((p1 * n).mg() == mg1 * n);
+    CHECK((p1 * n).eg() == eg1 * n);
+  }
+
+  CHECK(packed_score(10, 30).taper(0) == 10);
+  CHECK(packed_score(10, 30).taper(128) == 20);
+  CHECK(packed_score(10, 30).taper(256) == 30);
+}
+
 // Verify phase range.
 TEST_CASE("eval_phase")
 {
@@ -563,6 +877,476 @@ TEST_CASE("eval_flip")
                  });
 }
 
+TEST_CASE("material_key")
+{
+  for (const auto &test : test_set())
+    foreach_game(100, test.state,
+                 [](const state &pos, const move &)
+                 {
+                   CHECK(pos.material_key() == zobrist::material_hash(pos));
+                   CHECK(pos.color_flip().material_key()
+                         == zobrist::material_hash(pos.color_flip()));
+                 });
+
+  // Same material, different positions.
+  const state s1("4k3/8/8/8/8/8/4P3/4K2R w K - 0 1");
+  const state s2("7k/4P3/8/8/8/8/8/R3K3 b - - 0 1");
+  CHECK(s1.material_key() == s2.material_key());
+
+  const state s3("4k3/8/8/8/8/8/4P3/4K2B w - - 0 1");
+  CHECK(s1.material_key() != s3.material_key());
+}
+
+TEST_CASE("material_table")
+{
+  material_table table;
+
+  const state start(state::setup::start);
+  const auto &e(table.probe(start));
+  CHECK(e.key == start.material_key());
+  CHECK(e.phase == phase256(start));
+  CHECK(e.material[WHITE] == e.material[BLACK]);
+  CHECK(e.scale[WHITE] == material_entry::SCALE_NORMAL);
+  CHECK(!e.draw);
+
+  // Bare kings: the zero material key must not match an empty slot.
+  const state kk("4k3/8/8/8/8/8/8/4K3 w - - 0 1");
+  CHECK(kk.material_key() == 0);
+  CHECK(table.probe(kk).draw);
+  CHECK(table.probe(kk).phase == 256);
+
+  CHECK(table.probe(state("4k3/8/8/8/8/8/8/2B1K3 w - - 0 1")).draw);
+  CHECK(table.probe(state("4k3/8/8/8/2n5/8/8/2B1K3 w - - 0 1")).draw);
+  CHECK(!table.probe(state("4k3/8/8/8/8/8/8/2R1K3 w - - 0 1")).draw);
+  CHECK(!table.probe(state("4k3/8/8/8/8/8/3P4/2B1K3 w - - 0 1")).draw);
+
+  const state krkb("4k3/8/2b5/8/8/8/8/2R1K3 w - - 0 1");
+  CHECK(table.probe(krkb).scale[WHITE] < material_entry::SCALE_NORMAL);
+  CHECK(table.probe(krkb).scale[BLACK] == 0);
+
+  const state knnk("4k3/8/8/8/8/8/8/1NN1K3 w - - 0 1");
+  CHECK(table.probe(knnk).scale[WHITE] == 0);
+  const state kbnk("4k3/8/8/8/8/8/8/1NB1K3 w - - 0 1");
+  CHECK(table.probe(kbnk).scale[WHITE] == material_entry::SCALE_NORMAL);
+
+  const state krk("4k3/8/8/8/8/8/8/2R1K3 w - - 0 1");
+  CHECK(table.probe(krk).scale[WHITE] == material_entry::SCALE_NORMAL);
+
+  CHECK(eval(kk) == 0);
+  CHECK(eval(knnk) == 0);
+  CHECK(eval(krk) > 0);
+  CHECK(eval(krkb) < eval(krk));
+}
+
+TEST_CASE("endgame")
+{
+  // Mating material against a bare king.
+  const state krk("8/8/8/4k3/8/8/8/2R1K3 w - - 0 1");
+  CHECK(material_db.probe(krk).endgame.value);
+  CHECK(eval(krk) > KNOWN_WIN / 2);
+  CHECK(eval(krk.color_flip()) > KNOWN_WIN / 2);
+  CHECK(eval(state("8/8/8/4k3/8/8/8/2R1K3 b - - 0 1")) < -KNOWN_WIN / 2);
+  CHECK(lazy_eval(krk) == eval(krk));
+  CHECK(features(krk).recognized);
+  CHECK(features(krk).value == eval(krk));
+
+  // The weak king is driven to the edge.
+  CHECK(eval(state("k7/8/8/8/8/8/8/2R1K3 w - - 0 1"))
+        > eval(state("8/8/8/3k4/8/8/8/2R1K3 w - - 0 1")));
+
+  // Knights alone aren't enough.
+  CHECK(!material_db.probe(state("4k3/8/8/8/8/8/8/1NN1K3 w - - 0 1"))
+         .endgame.value);
+
+  // KBNK: the weak king must be driven to a corner of the colour of the
+  // bishop.
+  const state right("8/8/8/3K4/4N3/8/8/k1B5 w - - 0 1");
+  const state wrong("k7/8/8/3K4/4N3/8/8/2B5 w - - 0 1");
+  CHECK(eval(right) > KNOWN_WIN);
+  CHECK(eval(right) > eval(wrong));
+
+  // KPK with a rook pawn: the weak king in front of the pawn draws.
+  CHECK(eval(state("k7/8/8/8/8/8/P7/4K3 w - - 0 1")) == 0);
+  CHECK(eval(state("k7/8/8/8/8/8/P7/4K3 w - - 0 1").color_flip()) == 0);
+  CHECK(eval(state("k7/8/8/8/6P1/8/8/K7 w - - 0 1")) > KNOWN_WIN / 2);
+
+  // Rook pawns and the wrong bishop.
+  CHECK(eval(state("7k/8/8/8/8/8/7P/3BK3 w - - 0 1")) == 0);
+  CHECK(eval(state("7k/8/8/8/8/8/7P/2B1K3 w - - 0 1")) > 0);
+
+  // Bishops of opposite colours.
+  const state same("4k3/8/3b4/8/8/2BP4/1P6/4K3 w - - 0 1");
+  const state opposite("4k3/8/4b3/8/8/2BP4/1P6/4K3 w - - 0 1");
+  CHECK(eval(opposite) > 0);
+  CHECK(eval(opposite) < eval(same));
+}
+
+TEST_CASE("kpk")
+{
+  const auto won([](const char *fen)
+                 {
+                   const state s(fen);
+                   const score v(eval(s));
+
+                   // Same result for the color-flipped / mirrored positions.
+                   CHECK(eval(s.color_flip()) == v);
+
+                   return v != 0;
+                 });
+
+  // Stalemate.
+  CHECK(!won("4k3/4P3/4K3/8/8/8/8/8 b - - 0 1"));
+  CHECK(won("4k3/4P3/4K3/8/8/8/8/8 w - - 0 1"));
+
+  // King on the sixth rank in front of the pawn.
+  CHECK(won("4k3/8/4K3/4P3/8/8/8/8 b - - 0 1"));
+  CHECK(won("4k3/8/4K3/4P3/8/8/8/8 w - - 0 1"));
+
+  // Opposition.
+  CHECK(!won("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1"));
+  CHECK(won("8/4k3/8/4K3/4P3/8/8/8 b - - 0 1"));
+  CHECK(!won("8/3k4/8/3K4/3P4/8/8/8 w - - 0 1"));
+  CHECK(won("8/3k4/8/3K4/3P4/8/8/8 b - - 0 1"));
+
+  // Rule of the square.
+  CHECK(!won("8/8/8/3k4/8/8/7P/7K b - - 0 1"));
+  CHECK(won("8/8/8/k7/8/8/7P/7K b - - 0 1"));
+
+  // Rook pawn.
+  CHECK(!won("k7/8/1K6/P7/8/8/8/8 w - - 0 1"));
+  CHECK(!won("8/k7/8/P1K5/8/8/8/8 w - - 0 1"));
+  CHECK(won("8/8/8/P1K5/8/8/8/6k1 w - - 0 1"));
+
+  // The search stops at proven draws.
+  cache tt;
+  ab_search s({state("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1")}, &tt);
+  s.constraint.max_depth = 20;
+  s.run(true);
+  CHECK(s.stats.score_at_root == 0);
+  CHECK(s.stats.snodes + s.stats.qnodes < 10000);
+}
+
+TEST_CASE("eval_cache")
+{
+  eval_cache ec(10);
+  CHECK(ec.size() == 1024);
+
+  for (const auto &test : test_set())
+    foreach_game(100, test.state,
+                 [&ec](const state &pos, const move &)
+                 {
+                   CHECK(ec.eval(pos) == eval(pos));
+                   CHECK(ec.eval(pos) == eval(pos));
+                 });
+
+  if (eval_cache::stats_enabled)
+  {
+    CHECK(ec.stats.probes > 0);
+    CHECK(ec.stats.hits >= ec.stats.probes / 2);
+  }
+
+  const state s(state::setup::start);
+  ec.clear();
+  ec.stats.reset();
+  ec.eval(s);
+  ec.eval(s);
+  ec.eval(s.color_flip());
+
+  if (eval_cache::stats_enabled)
+  {
+    CHECK(ec.stats.probes == 3);
+    CHECK(ec.stats.hits == 1);
+  }
+}
+
+// The lazy evaluation margin is a heuristic: it's exceeded only by positions
+// with extreme pawn structures or piece activity (e.g. many advanced passed
+// pawns in the end-game), which are rare enough not to matter for the search.
+TEST_CASE("lazy_eval")
+{
+  unsigned n(0), outliers(0);
+
+  for (const auto &test : test_set())
+    foreach_game(100, test.state,
+                 [&](const state &pos, const move &)
+                 {
+                   packed_score pcsq[2];
+                   for (square i(0); i < 64; ++i)
+                     if (pos[i] != EMPTY)
+                       pcsq[pos[i].color()] += db.pcsq(pos[i], i);
+                   CHECK(pos.pcsq(BLACK) == pcsq[BLACK]);
+                   CHECK(pos.pcsq(WHITE) == pcsq[WHITE]);
+
+                   const score error(std::abs(eval(pos) - lazy_eval(pos)));
+                   CHECK(lazy_eval(pos) == lazy_eval(pos.color_flip()));
+
+                   ++n;
+                   if (error > LAZY_EVAL_MARGIN)
+                     ++outliers;
+                 });
+
+  CHECK(n);
+  CHECK(outliers * 100 <= n);
+}
+
+TEST_CASE("eval_batch")
+{
+  std::vector<state> positions;
+
+  for (const auto &test : test_set())
+    foreach_game(100, test.state,
+                 [&positions](const state &pos, const move &)
+                 {
+                   positions.push_back(pos);
+                   positions.push_back(pos.color_flip());
+                 });
+
+  // Enough positions to use more threads.
+  while (positions.size() < 20000)
+  {
+    const auto n(positions.size());
+    positions.reserve(2 * n);
+    std::copy_n(positions.begin(), n, std::back_inserter(positions));
+  }
+
+  std::vector<score> expected;
+  for (const auto &p : positions)
+    expected.push_back(eval(p));
+
+  for (unsigned threads : {1, 4})
+  {
+    std::vector<score> scores(positions.size(), INF);
+    eval_batch(positions, scores, threads);
+    CHECK(scores == expected);
+  }
+
+  // Empty and partial batches.
+  std::vector<score> scores;
+  eval_batch(span<const state>(), scores);
+
+  scores.assign(300, INF);
+  eval_batch(span<const state>(positions.data(), 300), scores);
+  CHECK(std::equal(scores.begin(), scores.end(), expected.begin()));
+}
+
+TEST_CASE("eval_parameters")
+{
+  // Same values of `db` but a different object (no incremental piece/square
+  // scores, no material table).
+  nlohmann::json j;
+  db.save(j);
+  const parameters same(j);
+
+  j["pawn"]["doubled_e"] = -30;
+  j["pawn"]["doubled_m"] = -30;
+  j["pcsq"]["knight_trapped_base_m"] = 0;
+  const parameters other(j);
+
+  unsigned n(0), different(0);
+
+  for (const auto &test : test_set())
+    foreach_game(10, test.state,
+                 [&](const state &pos, const move &)
+                 {
+                   CHECK(eval(pos, db) == eval(pos));
+                   CHECK(eval(pos, same) == eval(pos));
+
+                   ++n;
+                   if (eval(pos, other) != eval(pos))
+                     ++different;
+                 });
+
+  CHECK(n);
+  CHECK(different);
+}
+
+TEST_CASE("baked_parameters")
+{
+  // Tables computed by the compiler.
+  static_assert(baked_parameters::values.bishop_pair() == 30, "");
+  static_assert(baked_parameters::values.pawn_passed(6)
+                == packed_score(70, 140), "");
+
+  // Same tables computed at run time.
+  const parameters builtin(parameters::builtin);
+
+  nlohmann::json j1, j2;
+  builtin.save(j1);
+  baked_parameters::values.save(j2);
+  CHECK(j1 == j2);
+
+  for (unsigned p(0); p < piece::sup_id; ++p)
+    for (square i(0); i < 64; ++i)
+      CHECK(builtin.pcsq(piece(p), i)
+            == values(baked_parameters()).pcsq(piece(p), i));
+
+  for (const auto &test : test_set())
+    foreach_game(10, test.state,
+                 [&builtin](const state &pos, const move &)
+                 {
+                   CHECK(eval(pos, builtin) == eval(pos, baked_parameters()));
+                 });
+}
+
+TEST_CASE("tuner")
+{
+  std::istringstream in(
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - c9 \"1/2-1/2\";\n"
+    "4k3/8/8/3q4/4P3/8/8/4K3 w - - 0 1 [1.0]\n"
+    "8/8/8/8 w\n"
+    "4k3/8/8/8/8/8/8/4K3 w - - c9 \"*\";\n");
+
+  std::vector<tuner::sample> samples;
+  CHECK(tuner::read(in, samples) == 2);
+  REQUIRE(samples.size() == 2);
+
+  CHECK(samples[0].position == state());
+  CHECK(samples[0].result == doctest::Approx(0.5));
+
+  // The hanging queen is captured.
+  CHECK(samples[1].position.piece_count(BLACK, piece::queen) == 0);
+  CHECK(samples[1].position.captures().empty());
+  CHECK(samples[1].result == doctest::Approx(1.0));
+
+  samples.clear();
+  for (const auto &test : test_set())
+    foreach_game(1, test.state,
+                 [&samples](const state &pos, const move &)
+                 {
+                   if (samples.size() < 2000)
+                     samples.push_back({tuner::quiet(pos, db),
+                                        random::between(0, 2) / 2.0});
+                 });
+
+  const double k(1.0);
+  const double e(tuner::error(samples, db, k, 1));
+  CHECK(e > 0.0);
+  CHECK(tuner::error(samples, db, k, 4) == doctest::Approx(e));
+
+  const double best_k(tuner::best_k(samples, db));
+  CHECK(tuner::error(samples, db, best_k) <= e);
+
+  const parameters tuned(tuner::tune(samples, db, k, 1));
+  CHECK(tuner::error(samples, tuned, k) <= e);
+}
+
+TEST_CASE("features")
+{
+  const auto weights(feature_weights(values(engine_parameters())));
+
+  std::stringstream cache;
+  std::vector<feature_vector> extracted;
+
+  for (const auto &test : test_set())
+    foreach_game(20, test.state,
+                 [&](const state &pos, const move &)
+                 {
+                   for (const state &s : {pos, pos.color_flip()})
+                   {
+                     const auto fv(features(s));
+                     CHECK(fv.eval(weights) == eval(s));
+
+                     for (std::size_t i(0); i < fv.features.size(); ++i)
+                     {
+                       CHECK(fv.features[i].count);
+                       CHECK(fv.features[i].index < FEATURES);
+                       if (i)
+                         CHECK(fv.features[i - 1].index
+                               < fv.features[i].index);
+                     }
+
+                     CHECK(fv.save(cache));
+                     extracted.push_back(fv);
+                   }
+                 });
+
+  CHECK(!extracted.empty());
+
+  for (const auto &expected : extracted)
+  {
+    feature_vector fv;
+    REQUIRE(fv.load(cache));
+
+    CHECK(fv.phase == expected.phase);
+    CHECK(fv.scale_stm == expected.scale_stm);
+    CHECK(fv.scale_xstm == expected.scale_xstm);
+    CHECK(fv.recognized == expected.recognized);
+    CHECK(fv.value == expected.value);
+    REQUIRE(fv.features.size() == expected.features.size());
+    for (std::size_t i(0); i < fv.features.size(); ++i)
+    {
+      CHECK(fv.features[i].index == expected.features[i].index);
+      CHECK(fv.features[i].count == expected.features[i].count);
+      CHECK(fv.features[i].phase == expected.features[i].phase);
+    }
+  }
+
+  feature_vector fv;
+  CHECK(!fv.load(cache));
+}
+
+TEST_CASE("nnue")
+{
+  nnue::net.randomize();
+  CHECK(nnue::net.id());
+  CHECK(nnue::enable(true));
+
+  unsigned incremental(0);
+
+  for (const auto &test : test_set())
+    foreach_game(10, test.state,
+                 [&incremental](const state &pos, const move &)
+                 {
+                   nnue::accumulator acc;
+                   nnue::net.refresh(pos, acc);
+
+#if defined(TESTUDO_NNUE)
+                   if (pos.accumulator().id == nnue::net.id())
+                   {
+                     ++incremental;
+                     CHECK(std::equal(&acc.v[0][0],
+                                      &acc.v[0][0] + 2 * nnue::HIDDEN,
+                                      &pos.accumulator().v[0][0]));
+                   }
+#endif
+
+                   CHECK(nnue::net.evaluate(acc, pos.side())
+                         == nnue::net.evaluate_scalar(acc, pos.side()));
+
+                   // Features are relative to the side, so the evaluation is
+                   // symmetrical by construction.
+                   CHECK(eval(pos) == eval(pos.color_flip()));
+                 });
+
+#if defined(TESTUDO_NNUE)
+  CHECK(incremental);
+#endif
+
+  const std::string f("test.nnue");
+  CHECK(nnue::net.save(f));
+
+  const state s(state::setup::start);
+  const auto v(eval(s));
+
+  auto n1(std::make_unique<nnue::network>());
+  CHECK(!n1->id());
+  CHECK(n1->load(f));
+  CHECK(n1->id());
+  CHECK(n1->id() != nnue::net.id());
+
+  nnue::accumulator acc;
+  n1->refresh(s, acc);
+  CHECK(n1->evaluate(acc, s.side()) == v);
+
+  std::remove(f.c_str());
+  CHECK(!n1->load(f));
+
+  CHECK(nnue::enable(false));
+  CHECK(!nnue::enabled());
+  nnue::net = nnue::network();
+  CHECK(!nnue::enable(true));
+}
+
 TEST_CASE("king_shield")
 {
   // Cannot castle anymore: just consider the current pawn shield (full
@@ -598,79 +1382,82 @@ TEST_CASE("pawn_structure")
 {
   const state s1("8/8/8/8/8/8/P7/K6k w - -");
   const score_vector sv1(s1);
-  CHECK(sv1.pawns_e[WHITE] == db.pawn_passed_e(1) + db.pawn_weak_e(FILE_A));
-  CHECK(sv1.pawns_m[WHITE]
-        == db.pawn_passed_m(1) + db.pawn_weak_open_m(FILE_A));
+  CHECK(sv1.pawns[WHITE].eg()
+        == db.pawn_passed(1).eg() + db.pawn_weak_e(FILE_A));
+  CHECK(sv1.pawns[WHITE].mg()
+        == db.pawn_passed(1).mg() + db.pawn_weak_open_m(FILE_A));
 
   const state s2("8/P7/8/8/8/8/8/K6k w - -");
   const score_vector sv2(s2);
-  CHECK(sv2.pawns_e[WHITE] == db.pawn_passed_e(6) + db.pawn_weak_e(FILE_A));
-  CHECK(sv2.pawns_m[WHITE]
-        == db.pawn_passed_m(6) + db.pawn_weak_open_m(FILE_A));
+  CHECK(sv2.pawns[WHITE].eg()
+        == db.pawn_passed(6).eg() + db.pawn_weak_e(FILE_A));
+  CHECK(sv2.pawns[WHITE].mg()
+        == db.pawn_passed(6).mg() + db.pawn_weak_open_m(FILE_A));
 
   const state s3("8/8/8/8/8/Pp6/1P6/K6k w - -");
   const score_vector sv3(s3);
-  CHECK(sv3.pawns_e[WHITE]
-        == db.pawn_protected_passed_e(2) + db.pawn_weak_e(FILE_B));
-  CHECK(sv3.pawns_m[WHITE]
-        == db.pawn_passed_m(2) + db.pawn_weak_m(FILE_B));
+  CHECK(sv3.pawns[WHITE].eg()
+        == db.pawn_protected_passed(2).eg() + db.pawn_weak_e(FILE_B));
+  CHECK(sv3.pawns[WHITE].mg()
+        == db.pawn_passed(2).mg() + db.pawn_weak_m(FILE_B));
 
   const state s4("8/Pp6/1P/8/8/8/8/K6k w - -");
   const score_vector sv4(s4);
-  CHECK(sv4.pawns_e[WHITE]
-        == db.pawn_protected_passed_e(6) + db.pawn_weak_e(FILE_B));
-  CHECK(sv4.pawns_m[WHITE]
-        == db.pawn_passed_m(6) + db.pawn_weak_m(FILE_B));
+  CHECK(sv4.pawns[WHITE].eg()
+        == db.pawn_protected_passed(6).eg() + db.pawn_weak_e(FILE_B));
+  CHECK(sv4.pawns[WHITE].mg()
+        == db.pawn_passed(6).mg() + db.pawn_weak_m(FILE_B));
 
   const state s5("8/8/Pp6/8/8/8/1P/K6k w - -");
   const score_vector sv5(s5);
-  CHECK(sv5.pawns_e[WHITE]
-        == db.pawn_passed_e(5) + db.pawn_weak_e(FILE_B));
-  CHECK(sv5.pawns_m[WHITE]
-        == db.pawn_passed_m(5) + db.pawn_weak_m(FILE_B));
+  CHECK(sv5.pawns[WHITE].eg()
+        == db.pawn_passed(5).eg() + db.pawn_weak_e(FILE_B));
+  CHECK(sv5.pawns[WHITE].mg()
+        == db.pawn_passed(5).mg() + db.pawn_weak_m(FILE_B));
 
   const state s6("8/8/8/PP/8/8/8/K6k w - -");
   const score_vector sv6(s6);
-  CHECK(sv6.pawns_e[WHITE] == 2 * db.pawn_protected_passed_e(4));
-  CHECK(sv6.pawns_m[WHITE] == 2 * db.pawn_passed_m(4));
+  CHECK(sv6.pawns[WHITE].eg() == 2 * db.pawn_protected_passed(4).eg());
+  CHECK(sv6.pawns[WHITE].mg() == 2 * db.pawn_passed(4).mg());
 
   const state s7("8/8/3p4/3P4/3P4/8/8/K6k w - -");
   const score_vector sv7(s7);
-  CHECK(sv7.pawns_e[WHITE]
-        == 2 * db.pawn_weak_e(FILE_D) + db.pawn_doubled_e());
-  CHECK(sv7.pawns_m[WHITE]
-        == 2 * db.pawn_weak_m(FILE_D) + db.pawn_doubled_m());
+  CHECK(sv7.pawns[WHITE].eg()
+        == 2 * db.pawn_weak_e(FILE_D) + db.pawn_doubled().eg());
+  CHECK(sv7.pawns[WHITE].mg()
+        == 2 * db.pawn_weak_m(FILE_D) + db.pawn_doubled().mg());
 
   const state s8("8/8/8/3P4/3P4/8/8/K6k w - -");
   const score_vector sv8(s8);
-  CHECK(sv8.pawns_e[WHITE]
-        == 2 * db.pawn_weak_e(FILE_D) + db.pawn_passed_e(4)
-           + db.pawn_doubled_e());
-  CHECK(sv8.pawns_m[WHITE]
-        == 2 * db.pawn_weak_open_m(FILE_D) + db.pawn_passed_m(4)
-           + db.pawn_doubled_m());
+  CHECK(sv8.pawns[WHITE].eg()
+        == 2 * db.pawn_weak_e(FILE_D) + db.pawn_passed(4).eg()
+           + db.pawn_doubled().eg());
+  CHECK(sv8.pawns[WHITE].mg()
+        == 2 * db.pawn_weak_open_m(FILE_D) + db.pawn_passed(4).mg()
+           + db.pawn_doubled().mg());
 
   const state s8b("7r/8/8/3P4/3P4/8/8/K6k w - -");
   const score_vector sv8b(s8b);
-  CHECK(sv8b.pawns_e[WHITE]
-        == 2 * db.pawn_weak_open_e(FILE_D) + db.pawn_passed_e(4)
-           + db.pawn_doubled_e());
-  CHECK(sv8b.pawns_m[WHITE]
-        == 2 * db.pawn_weak_open_m(FILE_D) + db.pawn_passed_m(4)
-           + db.pawn_doubled_m());
+  CHECK(sv8b.pawns[WHITE].eg()
+        == 2 * db.pawn_weak_open_e(FILE_D) + db.pawn_passed(4).eg()
+           + db.pawn_doubled().eg());
+  CHECK(sv8b.pawns[WHITE].mg()
+        == 2 * db.pawn_weak_open_m(FILE_D) + db.pawn_passed(4).mg()
+           + db.pawn_doubled().mg());
 
   const state s9("8/1p6/8/3P4/3P4/2P5/8/K6k w - -");
   const score_vector sv9(s9);
-  CHECK(sv9.pawns_e[WHITE]
-        == db.pawn_passed_e(4) + db.pawn_doubled_e() + db.pawn_weak_e(FILE_C));
-  CHECK(sv9.pawns_m[WHITE]
-        == db.pawn_passed_m(4) + db.pawn_doubled_m()
+  CHECK(sv9.pawns[WHITE].eg()
+        == db.pawn_passed(4).eg() + db.pawn_doubled().eg()
+           + db.pawn_weak_e(FILE_C));
+  CHECK(sv9.pawns[WHITE].mg()
+        == db.pawn_passed(4).mg() + db.pawn_doubled().mg()
            + db.pawn_weak_open_m(FILE_C));
 
   const state s10("8/8/8/8/8/1PP5/8/K6k w - -");
   const score_vector sv10(s10);
-  CHECK(sv10.pawns_e[WHITE] == 2 * db.pawn_protected_passed_e(2));
-  CHECK(sv10.pawns_m[WHITE] == 2 * db.pawn_passed_m(2));
+  CHECK(sv10.pawns[WHITE].eg() == 2 * db.pawn_protected_passed(2).eg());
+  CHECK(sv10.pawns[WHITE].mg() == 2 * db.pawn_passed(2).mg());
 }
 
 }  // TEST_SUITE "EVAL"
@@ -689,6 +1476,22 @@ TEST_CASE("search_with_no_move_available")
   CHECK(!m);
 }
 
+TEST_CASE("search_deep_start")
+{
+  const state p(state::setup::start);
+  const move stored(p.moves().back());
+
+  // A deep entry for the root (e.g. from a hash file) without the entries
+  // of the subtree: the first iteration is slow and it's interrupted.
+  cache tt;
+  tt.insert(p.hash(), stored, 20 * ab_search::PLY, score_type::exact, 0);
+
+  ab_search s({p}, &tt);
+  s.resume = true;
+  s.constraint.max_nodes = 1;
+  CHECK(s.run(false) == stored);
+}
+
 TEST_CASE("draw_position")
 {
   // From a game with TSCP.
@@ -707,9 +1510,11 @@ TEST_CASE("draw_position2")
   // From a game with TSCP.
   const state p("q7/6k1/1p4p1/3p4/2pP1Q1P/p1P1PK2/2P4P/8 w - - 8 61");
 
+  // Without table cutoffs at PV nodes the perpetual check is proven one ply
+  // later.
   cache tt;
   ab_search s({p}, &tt);
-  s.constraint.max_depth = 10;
+  s.constraint.max_depth = 11;
 
   s.run(true);
   CHECK(s.stats.score_at_root == 0);
@@ -728,6 +1533,137 @@ TEST_CASE("draw_position3")
   CHECK(s.stats.score_at_root == 0);
 }
 
+TEST_CASE("endgame_search")
+{
+  cache tt;
+
+  const state kqk("8/8/8/4k3/8/8/8/3QK3 w - - 0 1");
+  ab_search s1({kqk}, &tt);
+  s1.constraint.max_depth = 20;
+  s1.constraint.condition = [&] { return is_mate(s1.stats.score_at_root); };
+  s1.run(true);
+  CHECK(is_mate(s1.stats.score_at_root));
+  CHECK(s1.stats.score_at_root > 0);
+
+  // Insufficient material.
+  tt.clear();
+  const state kbkn("4k3/8/8/8/8/8/8/2B1K1n1 w - - 0 1");
+  ab_search s2({kbkn}, &tt);
+  s2.constraint.max_depth = 6;
+  s2.run(true);
+  CHECK(s2.stats.score_at_root == 0);
+}
+
+TEST_CASE("tablebase")
+{
+  tablebase::clear();
+
+  // Tables reached by captures / promotions are required.
+  CHECK(!tablebase::generate("KPK"));
+  CHECK(!tablebase::generate("KQKQ"));
+
+  // Three pieces tables are built in a fraction of a second.
+  for (const auto &name : tablebase::materials())
+    if (name.size() == 3)
+      CHECK(tablebase::generate(name));
+
+  // Longest mates (plies) from the literature.
+  CHECK(tablebase::info("KQK").longest == 19);
+  CHECK(tablebase::info("KRK").longest == 31);
+  CHECK(tablebase::info("KPK").longest == 55);
+  CHECK(tablebase::info("KBK").wins == 0);
+  CHECK(tablebase::info("KNK").losses == 0);
+
+  const auto probe([](const char *fen)
+                   {
+                     const state s(fen);
+                     score v1, v2;
+
+                     REQUIRE(tablebase::probe(s, &v1));
+                     REQUIRE(tablebase::probe(s.color_flip(), &v2));
+                     CHECK(v1 == v2);
+
+                     return v1;
+                   });
+
+  CHECK(probe("k7/1Q6/1K6/8/8/8/8/8 b - - 0 1") == -INF);     // mate
+  CHECK(probe("k7/8/1QK5/8/8/8/8/8 b - - 0 1") == 0);         // stalemate
+  CHECK(probe("k7/8/1K6/8/8/8/8/6Q1 w - - 0 1") == INF - 1);  // mate in 1
+  CHECK(probe("k7/8/1K6/8/8/8/8/6Q1 b - - 0 1") == -INF + 2);
+  CHECK(probe("8/8/8/3k4/8/8/7P/7K b - - 0 1") == 0);         // KPK draw
+
+  // Results of the KPK bitbase.
+  for (const square wp : {A2, B4, C7, D5, F3, H6})
+    for (square wk(0); wk < 64; ++wk)
+      for (square bk(0); bk < 64; ++bk)
+        for (const color stm : {BLACK, WHITE})
+        {
+          if (wk == wp || bk == wp || distance(wk, bk) <= 1
+              || (stm == WHITE && (pawn_attacks(WHITE, bb(wp)) & bb(bk))))
+            continue;
+
+          std::string fen;
+          for (unsigned r(8); r--;)
+          {
+            unsigned empty(0);
+            for (unsigned f(0); f < 8; ++f)
+            {
+              const square sq(to_square(f, r));
+              const char c(sq == wk ? 'K' : sq == wp ? 'P' : sq == bk ? 'k'
+                                                                      : 0);
+              if (!c)
+                ++empty;
+              else
+              {
+                if (empty)
+                  fen += char('0' + empty);
+                fen += c;
+                empty = 0;
+              }
+            }
+
+            if (empty)
+              fen += char('0' + empty);
+            if (r)
+              fen += '/';
+          }
+          fen += stm == WHITE ? " w - - 0 1" : " b - - 0 1";
+
+          score v;
+          REQUIRE(tablebase::probe(state(fen), &v));
+          CHECK((stm == WHITE ? v > 0 : v < 0) == kpk::probe(wk, wp, bk, stm));
+        }
+
+  // Positions not covered.
+  score v;
+  CHECK(!tablebase::probe(state("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1"), &v));
+  CHECK(tablebase::probe(state("4k3/8/8/8/8/8/8/R3K3 w - - 0 1"), &v));
+  CHECK(!tablebase::probe(state("4k3/8/8/8/8/8/8/RR2K3 w - - 0 1"), &v));
+
+  // The search finds the exact distance to mate.
+  const state kqk("8/8/8/4k3/8/8/8/3QK3 w - - 0 1");
+  REQUIRE(tablebase::probe(kqk, &v));
+  CHECK(is_mate(v));
+
+  cache tt;
+  ab_search s({kqk}, &tt);
+  s.constraint.max_depth = 3;
+  s.run(false);
+  CHECK(s.stats.score_at_root == v);
+  CHECK(s.stats.tbhits > 0);
+
+  // Tables are mapped from disk.
+  CHECK(tablebase::save("KQK", "."));
+  tablebase::clear();
+  CHECK(!tablebase::probe(kqk, &v));
+  CHECK(tablebase::init(".") == 1);
+  CHECK(tablebase::available("KQK"));
+  CHECK(probe("k7/8/1K6/8/8/8/8/6Q1 w - - 0 1") == INF - 1);
+
+  std::remove("./KQK.ttb");
+  tablebase::clear();
+}
+
 }  // TEST_SUITE "SEARCH"
 
 TEST_CASE("SAN")
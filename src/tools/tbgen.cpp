@@ -0,0 +1,79 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include "engine/testudo.h"
+
+#include "thirdparty/docopt/docopt.h"
+
+const char USAGE[] =
+ R"(Testudo Tablebase Generator
+
+Builds the Distance To Mate endgame tablebases (see `tablebase.h`) for every
+material configuration with up to the given number of pieces. Tables already
+present in the output directory are reused.
+
+Usage:
+  tbgen [--pieces=<n>] [--threads=<n>] [--dir=<dir>]
+  tbgen -h | --help
+
+Options:
+  -h --help           shows this screen and exit
+  --pieces=<n>        maximum number of pieces (kings included) [default: 4]
+  --threads=<n>       number of threads (0 is one per core) [default: 0]
+  --dir=<dir>         output directory [default: .]
+)";
+
+int main(int argc, char *const argv[])
+{
+  using namespace testudo;
+
+  log::setup_stream("tbgen");
+
+  const auto args(docopt::docopt(USAGE, {argv + 1, argv + argc}, true));
+
+  const auto pieces(static_cast<unsigned>(args.at("--pieces").asLong()));
+  const auto threads(static_cast<unsigned>(args.at("--threads").asLong()));
+  const auto dir(args.at("--dir").asString());
+
+  if (pieces > tablebase::MAX_PIECES)
+  {
+    std::cerr << "At most " << tablebase::MAX_PIECES << " pieces\n";
+    return EXIT_FAILURE;
+  }
+
+  tablebase::init(dir);
+
+  for (const auto &name : tablebase::materials())
+  {
+    if (name.size() > pieces || tablebase::available(name))
+      continue;
+
+    std::cout << name << "... " << std::flush;
+
+    const auto start(std::chrono::steady_clock::now());
+    if (!tablebase::generate(name, threads) || !tablebase::save(name, dir))
+    {
+      std::cerr << "\nCannot build " << name << '\n';
+      return EXIT_FAILURE;
+    }
+    const auto elapsed(std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start));
+
+    const auto info(tablebase::info(name));
+    std::cout << info.positions << " positions, " << info.wins << " wins, "
+              << info.losses << " losses, longest mate " << info.longest
+              << " plies (" << elapsed.count() << "ms)" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
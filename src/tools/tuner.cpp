@@ -0,0 +1,86 @@
+/*
+ *  This file is part of TESTUDO.
+ *
+ *  Copyright (C) 2018 Manlio Morini.
+ *
+ *  This Source Code Form is subject to the terms of the Mozilla Public
+ *  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+ *  You can obtain one at http://mozilla.org/MPL/2.0/
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "engine/testudo.h"
+
+#include "thirdparty/docopt/docopt.h"
+
+const char USAGE[] =
+ R"(Testudo Tuner
+
+Optimizes the evaluation parameters (Texel's tuning method). The starting
+values are read from `testudo.json` (if available) and the result is written
+back to the same file.
+
+Usage:
+  tuner [--iterations=<n>] [--threads=<n>] [--k=<k>] POSITIONS
+  tuner -h | --help
+
+Options:
+  -h --help           shows this screen and exit
+  POSITIONS           EPD file with the game result of every position
+                      (`c9 "1-0";` or `[1.0]` style)
+  --iterations=<n>    maximum number of local search passes [default: 100]
+  --threads=<n>       number of threads (0 is one per core) [default: 0]
+  --k=<k>             scaling constant (computed if missing)
+)";
+
+int main(int argc, char *const argv[])
+{
+  using namespace testudo;
+
+  log::setup_stream("tuner");
+
+  const auto args(docopt::docopt(USAGE, {argv + 1, argv + argc}, true));
+
+  std::ifstream in(args.at("POSITIONS").asString());
+  if (!in)
+  {
+    std::cerr << "Cannot open " << args.at("POSITIONS").asString() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  const auto threads(static_cast<unsigned>(args.at("--threads").asLong()));
+  const auto iterations(
+    static_cast<unsigned>(args.at("--iterations").asLong()));
+
+  std::vector<tuner::sample> samples;
+  std::cout << "Reading positions... " << std::flush;
+  std::cout << tuner::read(in, samples) << " positions" << std::endl;
+
+  if (samples.empty())
+    return EXIT_FAILURE;
+
+  const auto k_arg(args.at("--k"));
+  const double k(k_arg ? std::stod(k_arg.asString())
+                       : tuner::best_k(samples, db, threads));
+
+  std::cout << "K: " << k << "  initial error: "
+            << tuner::error(samples, db, k, threads) << std::endl;
+
+  const auto result(
+    tuner::tune(samples, db, k, iterations, threads,
+                [](unsigned i, double e)
+                {
+                  std::cout << "Iteration " << i << "  error: " << e
+                            << std::endl;
+                }));
+
+  if (!result.save())
+  {
+    std::cerr << "Cannot save the parameters\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}